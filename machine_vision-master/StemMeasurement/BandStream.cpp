@@ -0,0 +1,60 @@
+#include "BandStream.h"
+#include "FusedEqualize.h"
+#include "ImageContext.h"
+#include "StemWorkspace.h"
+
+#include <algorithm>
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace cv;
+
+const Mat &streamFramePlanes(const Mat &src, StemWorkspace &ws, ImageContext &ctx, int band_rows) {
+    const Size sz = src.size();
+    band_rows = std::max(band_rows,1);
+    Mat &median = ws.mat(WS_MEDIAN,sz,src.type());
+    Mat &hsv_equalized = ws.mat(WS_HSV_EQUALIZED,sz,CV_8UC3);
+    Mat &rgb_equalized = ws.mat(WS_RGB_EQUALIZED,sz,CV_8UC3);
+    Mat &gray = ws.mat(WS_GRAY,sz,CV_8UC1);
+    Mat &blurred = ws.mat(WS_GRAY_BLURRED,sz,CV_8UC1);
+
+    // median and the V histogram
+    int hist[256] = {0};
+    for(int y0=0; y0<sz.height; y0+=band_rows) {
+        const Range rows(y0,std::min(y0+band_rows,sz.height));
+        const int m0 = std::max(rows.start-1,0), m1 = std::min(rows.end+1,sz.height);
+        Mat &band_median = ws.mat(WS_BAND_MEDIAN,Size(sz.width,m1-m0),src.type());
+        medianBlur(src.rowRange(m0,m1),band_median,3);
+        Mat median_rows = median.rowRange(rows);
+        band_median.rowRange(rows.start-m0,rows.end-m0).copyTo(median_rows);
+        valueHistogram(median_rows,hist);
+    }
+    Mat &lut = ws.mat(WS_EQUALIZATION_LUT,Size(256,1),CV_8UC1);
+    equalizationLut(hist,int(sz.area()),lut);
+
+    // equalized planes; the blur of a row needs the gray rows around it, so it lags a row behind
+    int blurred_to = 0;
+    for(int y0=0; y0<sz.height; y0+=band_rows) {
+        const Range rows(y0,std::min(y0+band_rows,sz.height));
+        Mat hsv_rows = hsv_equalized.rowRange(rows);
+        Mat rgb_rows = rgb_equalized.rowRange(rows);
+        Mat gray_rows = gray.rowRange(rows);
+        equalizeRgb(median.rowRange(rows),lut,rgb_rows,gray_rows,&hsv_rows);
+        const int b1 = rows.end==sz.height ? rows.end : rows.end-1;
+        if(b1<=blurred_to)
+            continue;
+        const int g0 = std::max(blurred_to-1,0), g1 = std::min(b1+1,sz.height);
+        Mat &band_blurred = ws.mat(WS_BAND_BLURRED,Size(sz.width,g1-g0),CV_8UC1);
+        blur(gray.rowRange(g0,g1),band_blurred,Size(3,3));
+        Mat blurred_rows = blurred.rowRange(blurred_to,b1);
+        band_blurred.rowRange(blurred_to-g0,b1-g0).copyTo(blurred_rows);
+        blurred_to = b1;
+    }
+
+    ctx.reset(median);
+    ctx.setEqualization(lut);
+    ctx.setPlane(PLANE_HSV_EQUALIZED,hsv_equalized);
+    ctx.setPlane(PLANE_RGB_EQUALIZED,rgb_equalized);
+    ctx.setPlane(PLANE_GRAY_EQUALIZED,gray);
+    ctx.setPlane(PLANE_GRAY_BLURRED,blurred);
+    return median;
+}
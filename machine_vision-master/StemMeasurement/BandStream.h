@@ -0,0 +1,13 @@
+#pragma once
+#include <opencv2/core/core.hpp>
+
+class ImageContext;
+class StemWorkspace;
+
+// The 3x3 median of src and the equalized planes of ctx up to the blurred gray image, computed in strips of
+// band_rows rows so that a strip is still in cache when the next step reads it. The first pass takes the median and
+// the histogram of V; the second equalizes the strips with the LUT of that histogram, see equalizeRgb, and blurs the
+// gray ones. The median and the blur are computed with a row of halo, so every plane equals the whole image one.
+// Canny links edges over any distance and still runs on the whole frame; the unequalized HSV planes are left to ctx.
+// ctx is reset to the median, which is kept in WS_MEDIAN; the planes are in their usual workspace slots.
+const cv::Mat &streamFramePlanes(const cv::Mat &src, StemWorkspace &ws, ImageContext &ctx, int band_rows);
@@ -0,0 +1,412 @@
+#include "BatchRunner.h"
+#include "Calibration.h"
+#include "ImageLoader.h"
+#include "MeasurementPipeline.h"
+#include "Metrics.h"
+#include "RoiCache.h"
+#include "StemMeasurer.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+using namespace std;
+
+bool parseBatchOptions(int argc, char **argv, BatchOptions &opts) {
+    bool batch = false;
+    for(int i=1; i<argc; ++i) {
+        if(0==strcmp(argv[i],"-j") && i+1<argc) {
+            opts.workers = atoi(argv[++i]);
+            batch = true;
+        }
+        else if(0==strcmp(argv[i],"--decoders") && i+1<argc) {
+            opts.decoders = atoi(argv[++i]);
+            batch = true;
+        }
+        else if(0==strcmp(argv[i],"--queue") && i+1<argc)
+            opts.queue_depth = atoi(argv[++i]);
+        else if(0==strcmp(argv[i],"--schedule") && i+1<argc) {
+            if(!parseScheduleMode(argv[++i],opts.schedule))
+                fprintf(stderr,"Unknown schedule %s, using auto\n",argv[i]);
+            batch = true;
+        }
+        else if(0==strcmp(argv[i],"--pin"))
+            opts.pin_workers = true;
+        else if(0==strcmp(argv[i],"-o") && i+1<argc) {
+            opts.output = argv[++i];
+            batch = true;
+        }
+        else if(0==strcmp(argv[i],"--coarse") && i+1<argc)
+            opts.coarse_scale = atoi(argv[++i]);
+        else if(0==strcmp(argv[i],"--bands") && i+1<argc)
+            opts.band_rows = atoi(argv[++i]);
+        else if(0==strcmp(argv[i],"--coarse-report")) {
+            opts.coarse_report = true;
+            batch = true;
+        }
+        else if(0==strcmp(argv[i],"--track")) {
+            opts.track = true;
+            batch = true;
+        }
+        else if(0==strcmp(argv[i],"--mask-report")) {
+            opts.mask_report = true;
+            batch = true;
+        }
+        else if(0==strcmp(argv[i],"--plants"))
+            opts.all_plants = true;
+        else if(0==strcmp(argv[i],"--roi-cache") && i+1<argc)
+            opts.roi_cache = argv[++i];
+        else if(0==strcmp(argv[i],"--metrics") && i+1<argc)
+            opts.metrics_json = argv[++i];
+        else if(0==strcmp(argv[i],"--metrics-every") && i+1<argc)
+            opts.metrics_every = atof(argv[++i]);
+        else if(0==strcmp(argv[i],"--calibration") && i+1<argc)
+            opts.calibration = argv[++i];
+        else if(0==strcmp(argv[i],"--debug-dir") && i+1<argc)
+            opts.debug_dir = argv[++i];
+        else if(0==strcmp(argv[i],"--debug-level") && i+1<argc)
+            opts.debug_level = atoi(argv[++i]);
+        else
+            opts.inputs.push_back(argv[i]);
+    }
+    if(opts.inputs.size()!=1)
+        return true;
+    const string &in(opts.inputs.front());
+    return batch || in[0]=='@' || QFileInfo(QString::fromLocal8Bit(in.c_str())).isDir();
+}
+vector<string> collectImages(const vector<string> &inputs) {
+    vector<string> images;
+    QStringList filters;
+    filters << "*.jpg" << "*.jpeg" << "*.JPG" << "*.JPEG" << "*.png" << "*.bmp" << "*.tif" << "*.tiff";
+    for(const string &in : inputs) {
+        if(in[0]=='@') { // file list, one image per line
+            ifstream list(in.substr(1).c_str());
+            string line;
+            while(getline(list,line)) {
+                if(line.empty() || line[0]=='#')
+                    continue;
+                images.push_back(line);
+            }
+            continue;
+        }
+        QFileInfo info(QString::fromLocal8Bit(in.c_str()));
+        if(!info.isDir()) {
+            images.push_back(in);
+            continue;
+        }
+        QDir dir(info.absoluteFilePath());
+        for(const QString &name : dir.entryList(filters,QDir::Files|QDir::Readable,QDir::Name))
+            images.push_back(dir.filePath(name).toLocal8Bit().constData());
+    }
+    return images;
+}
+// One measuring mode compared with the reference mode over a set of images
+struct ModeStats
+{
+    int    images        = 0;
+    int    same_status   = 0;
+    double ms            = 0;
+    int    positions     = 0; // images where both runs found the wire and the plant top
+    double hang_line_sum = 0;
+    int    hang_line_max = 0;
+    double top_sum       = 0;
+    int    top_max       = 0;
+    int    widths        = 0; // images measured by both runs
+    double width_sum     = 0;
+    double width_max     = 0;
+};
+static void compareResults(const StemResult &ref, const StemResult &res, ModeStats &st) {
+    st.images++;
+    st.ms += res.elapsed_ms;
+    if(res.status==ref.status)
+        st.same_status++;
+    if(ref.plant_top>=0 && res.plant_top>=0) {
+        int d_line = abs(res.hang_line_x-ref.hang_line_x);
+        int d_top = abs(res.plant_top-ref.plant_top);
+        st.positions++;
+        st.hang_line_sum += d_line;
+        st.hang_line_max = std::max(st.hang_line_max,d_line);
+        st.top_sum += d_top;
+        st.top_max = std::max(st.top_max,d_top);
+    }
+    if(ref.status==STEM_OK && res.status==STEM_OK) {
+        double d_width = fabs(res.stem_width_px-ref.stem_width_px);
+        st.widths++;
+        st.width_sum += d_width;
+        st.width_max = std::max(st.width_max,d_width);
+    }
+}
+// Every image is measured at full resolution and with coarse_scale 4 and 8, results per image go to out and
+// the agreement with the full resolution results to stderr
+static int coarseReport(const vector<string> &images, FILE *out) {
+    const int scales[] = {1,4,8};
+    const int n = sizeof(scales)/sizeof(scales[0]);
+    vector<unique_ptr<StemMeasurer>> measurers;
+    for(int scale : scales) {
+        StemParams params;
+        params.coarse_scale = scale;
+        measurers.emplace_back(new StemMeasurer(params));
+    }
+    ModeStats stats[n];
+    fprintf(out,"image,coarse_scale,status,hang_line_x,plant_top,stem_width_px,ms\n");
+    for(const string &path : images) {
+        cv::Mat pic = loadImageRoi(path,measurers[0]->params().crop_area);
+        if(pic.empty()) {
+            fprintf(stderr,"%s: %s\n",path.c_str(),stemStatusName(STEM_LOAD_FAILED));
+            continue;
+        }
+        StemResult ref;
+        for(int i=0; i<n; ++i) {
+            StemResult res = measurers[i]->measure(pic);
+            if(i==0)
+                ref = res;
+            compareResults(ref,res,stats[i]);
+            fprintf(out,"%s,%d,%s,%d,%d,%.2f,%.1f\n",path.c_str(),scales[i],stemStatusName(res.status),
+                    res.hang_line_x,res.plant_top,res.stem_width_px,res.elapsed_ms);
+        }
+        fflush(out);
+    }
+    for(int i=0; i<n; ++i) {
+        const ModeStats &st(stats[i]);
+        if(st.images==0)
+            break;
+        fprintf(stderr,"scale %d: %.1f ms/image (%.2fx), same status %d/%d",scales[i],st.ms/st.images,
+                stats[0].ms/std::max(st.ms,1e-9),st.same_status,st.images);
+        if(st.positions>0)
+            fprintf(stderr,", |d hang line| %.2f avg %d max, |d plant top| %.2f avg %d max px",
+                    st.hang_line_sum/st.positions,st.hang_line_max,st.top_sum/st.positions,st.top_max);
+        if(st.widths>0)
+            fprintf(stderr,", |d width| %.3f avg %.3f max px",st.width_sum/st.widths,st.width_max);
+        fprintf(stderr,"\n");
+    }
+    return 0;
+}
+// Mask of an image named as in docs/notes.md: <dir>/images/<name>_original.<ext> has <dir>/masks/<name>_mask.<ext>,
+// other images a <name>_mask.<ext> next to them. Empty when there is none.
+static string maskPathFor(const string &image) {
+    size_t slash = image.find_last_of("/\\");
+    string dir = slash==string::npos ? string() : image.substr(0,slash+1);
+    string file = image.substr(dir.size());
+    size_t dot = file.rfind('.');
+    string name = file.substr(0,dot), ext = dot==string::npos ? string() : file.substr(dot);
+    const string original = "_original";
+    if(name.size()>original.size() && 0==name.compare(name.size()-original.size(),original.size(),original))
+        name.resize(name.size()-original.size());
+    vector<string> candidates;
+    const string images_dir = "images/";
+    if(dir.size()>=images_dir.size() && 0==dir.compare(dir.size()-images_dir.size(),images_dir.size(),images_dir))
+        candidates.push_back(dir.substr(0,dir.size()-images_dir.size())+"masks/"+name+"_mask"+ext);
+    candidates.push_back(dir+name+"_mask"+ext);
+    for(const string &c : candidates) {
+        if(QFileInfo(QString::fromLocal8Bit(c.c_str())).exists())
+            return c;
+    }
+    return string();
+}
+// Images with a stalk mask are measured with the edge based stemWidth and with measureWithMask, results per image go
+// to out and the agreement and speed of the mask mode to stderr
+static int maskReport(const vector<string> &images, FILE *out) {
+    StemMeasurer measurer;
+    const cv::Rect crop = measurer.params().crop_area;
+    ModeStats mask_stats;
+    double edge_ms = 0;
+    int without_mask = 0;
+    fprintf(out,"image,mode,status,stem_width_px,ms\n");
+    for(const string &path : images) {
+        string mask_path = maskPathFor(path);
+        if(mask_path.empty()) {
+            without_mask++;
+            continue;
+        }
+        cv::Mat pic = loadImageRoi(path,crop);
+        cv::Mat mask_bgr = loadImageRoi(mask_path,crop), mask;
+        if(pic.empty() || mask_bgr.empty() || mask_bgr.size()!=pic.size()) {
+            fprintf(stderr,"%s: %s\n",path.c_str(),stemStatusName(STEM_LOAD_FAILED));
+            continue;
+        }
+        cv::cvtColor(mask_bgr,mask,CV_BGR2GRAY);
+        StemResult ref = measurer.measure(pic);
+        StemResult res = measurer.measureWithMask(pic,mask);
+        edge_ms += ref.elapsed_ms;
+        compareResults(ref,res,mask_stats);
+        fprintf(out,"%s,edges,%s,%.2f,%.1f\n",path.c_str(),stemStatusName(ref.status),ref.stem_width_px,
+                ref.elapsed_ms);
+        fprintf(out,"%s,mask,%s,%.2f,%.1f\n",path.c_str(),stemStatusName(res.status),res.stem_width_px,
+                res.elapsed_ms);
+        fflush(out);
+    }
+    const ModeStats &st(mask_stats);
+    fprintf(stderr,"%d images measured, %d without a mask\n",st.images,without_mask);
+    if(st.images==0)
+        return 1;
+    fprintf(stderr,"edges: %.1f ms/image, mask: %.1f ms/image (%.2fx), same status %d/%d",
+            edge_ms/st.images,st.ms/st.images,edge_ms/std::max(st.ms,1e-9),st.same_status,st.images);
+    if(st.widths>0)
+        fprintf(stderr,", |d width| %.3f avg %.3f max px over %d stems",st.width_sum/st.widths,st.width_max,
+                st.widths);
+    fprintf(stderr,"\n");
+    return 0;
+}
+// The images are consecutive frames of one lane, each is searched around the positions found in the previous one
+static int trackSequence(const vector<string> &images, const StemParams &params, const StemCalibration &calibration,
+                         FILE *out) {
+    StemMeasurer measurer(params);
+    measurer.setCalibration(calibration);
+    StemTrack track;
+    int failed = 0, tracked = 0;
+    double tracked_ms = 0, searched_ms = 0;
+    fprintf(out,"image,status,hang_line_x,plant_top,stem_width_px,stem_width_mm,ms,tracked\n");
+    for(const string &path : images) {
+        cv::Mat pic = loadImageRoi(path,params.crop_area);
+        StemResult res;
+        if(pic.empty()) {
+            res.status = STEM_LOAD_FAILED;
+            track.valid = false;
+        }
+        else
+            res = measurer.measureTracked(pic,track);
+        if(res.status!=STEM_OK)
+            failed++;
+        if(res.tracked) {
+            tracked++;
+            tracked_ms += res.elapsed_ms;
+        }
+        else
+            searched_ms += res.elapsed_ms;
+        fprintf(out,"%s,%s,%d,%d,%.2f,%.3f,%.1f,%d\n",path.c_str(),stemStatusName(res.status),res.hang_line_x,
+                res.plant_top,res.stem_width_px,res.stem_width_mm,res.elapsed_ms,int(res.tracked));
+        fflush(out);
+    }
+    int searched = images.size()-tracked;
+    fprintf(stderr,"Tracked %d of %zu frames (%d failed), %.1f ms/tracked frame, %.1f ms/searched frame\n",tracked,
+            images.size(),failed,tracked_ms/std::max(tracked,1),searched_ms/std::max(searched,1));
+    return failed==0 ? 0 : 1;
+}
+static void writeMetrics(const BatchOptions &opts,const StageTimes *steps) {
+    if(opts.metrics_json.empty())
+        return;
+    Metrics::instance().stop();
+    if(!Metrics::instance().writeJson(opts.metrics_json,steps))
+        perror(opts.metrics_json.c_str());
+}
+int runBatch(const BatchOptions &opts) {
+    vector<string> images = collectImages(opts.inputs);
+    if(images.empty()) {
+        fprintf(stderr,"Usage: gl3_test [--schedule auto|inter|intra] [--pin] [-j workers] [--decoders n] "
+                       "[--queue depth] [-o results.csv] [--coarse 4|8] [--bands rows] [--coarse-report] [--track] "
+                       "[--roi-cache file] [--plants] [--mask-report] [--metrics report.json] "
+                       "[--metrics-every seconds] [--calibration marker_image] [--debug-dir dir] "
+                       "[--debug-level 0-3] <image|directory|@file_list>...\n");
+        return 2;
+    }
+    if(!opts.metrics_json.empty()) {
+        Metrics::instance().start();
+        Metrics::instance().startDump(opts.metrics_json,opts.metrics_every);
+    }
+    // the inputs are taken from the position of the marker image, so its scale is detected once for all of them
+    StemCalibration calibration;
+    if(!opts.calibration.empty()) {
+        CalibrationCache cache;
+        CalibrationData marker;
+        marker.m_server_path = opts.calibration;
+        calibration = cache.lookup(SensorPosition(),marker);
+        if(calibration.valid())
+            fprintf(stderr,"%s: %.4f mm/pixel\n",opts.calibration.c_str(),calibration.pixel_to_mm);
+    }
+    FILE *out = stdout;
+    if(!opts.output.empty()) {
+        out = fopen(opts.output.c_str(),"w");
+        if(!out) {
+            perror(opts.output.c_str());
+            return 2;
+        }
+    }
+    if(opts.coarse_report || opts.mask_report) {
+        // images are measured one at a time, all cores go to OpenCV
+        SchedulePlan plan = planSchedule(SCHEDULE_INTRA_IMAGE,images.size());
+        applySchedule(plan);
+        printSchedule(stderr,plan);
+        int res = opts.coarse_report ? coarseReport(images,out) : maskReport(images,out);
+        if(out!=stdout)
+            fclose(out);
+        writeMetrics(opts,nullptr);
+        return res;
+    }
+    if(opts.track) {
+        // frames depend on the previous one, so they are measured in order and all cores go to OpenCV
+        SchedulePlan plan = planSchedule(SCHEDULE_INTRA_IMAGE,images.size());
+        applySchedule(plan);
+        printSchedule(stderr,plan);
+        StemParams params;
+        params.coarse_scale = opts.coarse_scale;
+        params.band_rows = opts.band_rows;
+        int res = trackSequence(images,params,calibration,out);
+        if(out!=stdout)
+            fclose(out);
+        writeMetrics(opts,nullptr);
+        return res;
+    }
+    SchedulePlan plan = planSchedule(opts.schedule,images.size(),0,opts.workers);
+    if(opts.decoders>0)
+        plan.decoders = std::min<int>(opts.decoders,images.size());
+    plan.pin_workers = opts.pin_workers;
+    applySchedule(plan);
+    printSchedule(stderr,plan);
+
+    PipelineOptions pipeline_opts;
+    pipeline_opts.workers = plan.workers;
+    pipeline_opts.decoders = plan.decoders;
+    pipeline_opts.pin_workers = plan.pin_workers;
+    if(opts.queue_depth>0)
+        pipeline_opts.queue_depth = opts.queue_depth;
+    pipeline_opts.params.coarse_scale = opts.coarse_scale;
+    pipeline_opts.params.band_rows = opts.band_rows;
+    pipeline_opts.calibration = calibration;
+    pipeline_opts.all_plants = opts.all_plants;
+    RoiCache roi_cache;
+    if(!opts.roi_cache.empty()) {
+        if(roi_cache.open(opts.roi_cache))
+            pipeline_opts.roi_cache = &roi_cache;
+        else
+            fprintf(stderr,"Could not open the ROI cache %s, searching every image fully\n",opts.roi_cache.c_str());
+    }
+
+    fprintf(out,"image,status,hang_line_x,plant_top,stem_width_px,stem_width_mm,ms,allocated_bytes%s\n",
+            opts.all_plants ? ",plant,confidence" : "");
+    int failed = 0;
+    // called from the writer thread only
+    auto write = [&](size_t, const string &path, const StemResult &res) {
+        if(res.status!=STEM_OK)
+            failed++;
+        fprintf(out,"%s,%s,%d,%d,%.2f,%.3f,%.1f,%zu",path.c_str(),stemStatusName(res.status),
+                res.hang_line_x,res.plant_top,res.stem_width_px,res.stem_width_mm,res.elapsed_ms,
+                res.allocated_bytes);
+        if(opts.all_plants)
+            fprintf(out,",%d,%.2f",res.plant,res.confidence);
+        fprintf(out,"\n");
+        fflush(out);
+    };
+    PipelineStats stats = MeasurementPipeline(pipeline_opts).run(images,write);
+    if(out!=stdout)
+        fclose(out);
+
+    fprintf(stderr,"Measured %zu images (%d failed) with %d decoders and %d workers in %.2f s, %.2f images/s\n",
+            images.size(),failed,pipeline_opts.decoders,pipeline_opts.workers,stats.wall_s,
+            images.size()/stats.wall_s);
+    printPipelineStats(stderr,stats);
+    writeMetrics(opts,&stats.steps);
+    if(pipeline_opts.roi_cache) {
+        printRoiCacheStats(stderr,roi_cache.stats());
+        fprintf(stderr,"all laps ");
+        printRoiCacheStats(stderr,roi_cache.cumulativeStats());
+    }
+    return failed==0 ? 0 : 1;
+}
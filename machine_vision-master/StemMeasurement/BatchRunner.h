@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "ThreadSchedule.h"
+
+struct BatchOptions
+{
+    std::vector<std::string> inputs;          // images, directories or @file_lists
+    std::string              output;          // result rows go to stdout when empty
+    ScheduleMode             schedule    = SCHEDULE_AUTO;
+    bool                     pin_workers = false;
+    int                      workers     = 0; // measuring threads, 0 - as planned by the schedule
+    int                      decoders    = 0; // decoding threads, 0 - as planned by the schedule
+    int                      queue_depth = 0; // 0 - PipelineOptions default
+    std::string              debug_dir;       // where DebugSink writes its images
+    int                      debug_level = 0; // DebugLevel, images are not written by default
+    int                      coarse_scale  = 1;     // StemParams::coarse_scale
+    bool                     coarse_report = false; // compare coarse_scale 4 and 8 with full resolution instead
+    int                      band_rows     = 0;     // StemParams::band_rows
+    bool                     track         = false; // inputs are one sequence, measured in order with tracking
+    std::string              roi_cache;             // RoiCache file seeding the search from the previous lap
+    bool                     all_plants    = false; // a row per plant in the frame, with its confidence
+    bool                     mask_report   = false; // compare measureWithMask on images with a stalk mask instead
+    std::string              metrics_json;          // stage latency and counter report, see Metrics
+    double                   metrics_every = 0;     // seconds between rewrites of metrics_json during the run
+    std::string              calibration;           // image with a QR marker giving the scale of every input
+};
+
+// Returns false if the command line does not request batch processing ( single image, no options )
+bool parseBatchOptions(int argc, char **argv, BatchOptions &opts);
+std::vector<std::string> collectImages(const std::vector<std::string> &inputs);
+int runBatch(const BatchOptions &opts);
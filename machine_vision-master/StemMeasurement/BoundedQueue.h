@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Fixed capacity multi-producer multi-consumer queue after D. Vyukov's bounded MPMC design. Every cell carries a
+// sequence number telling whether it is ready to be written or read in the current lap, so producers and consumers
+// only compare-and-swap their own position counter and never take a lock. The capacity is rounded up to a power of
+// two, at least 2 so that the "filled" and "free in the next lap" sequence numbers of a cell differ. tryPush and
+// tryPop return false instead of blocking, callers decide how to wait.
+template <class T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) {
+        size_t n = 2;
+        while(n<capacity)
+            n <<= 1;
+        m_mask = n-1;
+        m_cells.reset(new Cell[n]);
+        for(size_t i=0; i<n; ++i)
+            m_cells[i].seq.store(i,std::memory_order_relaxed);
+    }
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    // v is moved from only when the push succeeds
+    bool tryPush(T &&v) {
+        size_t pos = m_enqueue.load(std::memory_order_relaxed);
+        for(;;) {
+            Cell &c = m_cells[pos&m_mask];
+            intptr_t diff = intptr_t(c.seq.load(std::memory_order_acquire))-intptr_t(pos);
+            if(diff==0) {
+                if(m_enqueue.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed)) {
+                    c.value = std::move(v);
+                    c.seq.store(pos+1,std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(diff<0)
+                return false; // full
+            else
+                pos = m_enqueue.load(std::memory_order_relaxed);
+        }
+    }
+    bool tryPop(T &v) {
+        size_t pos = m_dequeue.load(std::memory_order_relaxed);
+        for(;;) {
+            Cell &c = m_cells[pos&m_mask];
+            intptr_t diff = intptr_t(c.seq.load(std::memory_order_acquire))-intptr_t(pos+1);
+            if(diff==0) {
+                if(m_dequeue.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed)) {
+                    v = std::move(c.value);
+                    c.value = T(); // do not keep the item alive until the cell is reused
+                    c.seq.store(pos+m_mask+1,std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(diff<0)
+                return false; // empty
+            else
+                pos = m_dequeue.load(std::memory_order_relaxed);
+        }
+    }
+    size_t capacity() const { return m_mask + 1; }
+    // exact only while no other thread uses the queue
+    size_t size() const {
+        size_t out = m_dequeue.load(std::memory_order_relaxed);
+        size_t in = m_enqueue.load(std::memory_order_relaxed);
+        return in>out ? in-out : 0;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        T                   value;
+    };
+    std::unique_ptr<Cell[]> m_cells;
+    size_t                  m_mask = 0;
+    // the counters are written by different threads, keep them on separate cache lines
+    alignas(64) std::atomic<size_t> m_enqueue{0};
+    alignas(64) std::atomic<size_t> m_dequeue{0};
+};
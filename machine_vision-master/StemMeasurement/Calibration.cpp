@@ -0,0 +1,85 @@
+#include "Calibration.h"
+
+#include <cmath>
+#include <cstdio>
+#include <tuple>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+// cv::QRCodeDetector came with 3.4.4; 2.4 defines CV_VERSION_EPOCH and counts its minor version in CV_VERSION_MAJOR
+#if !defined(CV_VERSION_EPOCH) && (CV_VERSION_MAJOR>3 || (CV_VERSION_MAJOR==3 && CV_VERSION_MINOR==4 && \
+                                                          CV_VERSION_REVISION>=4))
+#define STEM_HAVE_QR_DETECTOR
+#include <opencv2/objdetect.hpp>
+#endif
+
+using namespace std;
+using namespace cv;
+
+StemCalibration markerCalibration(const vector<Point2f> &corners, float marker_mm) {
+    StemCalibration res;
+    if(corners.size()!=4 || marker_mm<=0)
+        return res;
+    // the diagonals of a marker with sides of marker_mm are marker_mm*sqrt(2) long
+    double diagonal = (norm(corners[0]-corners[2])+norm(corners[1]-corners[3]))/2;
+    if(diagonal>=1)
+        res.pixel_to_mm = float(marker_mm*std::sqrt(2.0)/diagonal);
+    return res;
+}
+StemCalibration detectCalibration(const Mat &image, float marker_mm) {
+#ifdef STEM_HAVE_QR_DETECTOR
+    if(image.empty())
+        return StemCalibration();
+    Mat gray;
+    if(image.channels()==3)
+        cvtColor(image,gray,CV_BGR2GRAY);
+    else
+        gray = image;
+    vector<Point2f> corners;
+    QRCodeDetector detector;
+    if(!detector.detect(gray,corners))
+        return StemCalibration();
+    return markerCalibration(corners,marker_mm);
+#else
+    (void)image;
+    (void)marker_mm;
+    return StemCalibration();
+#endif
+}
+bool CalibrationCache::Key::operator<(const Key &o) const {
+    return std::tie(height,tilt,rotation,path)<std::tie(o.height,o.tilt,o.rotation,o.path);
+}
+CalibrationCache::CalibrationCache(float marker_mm) : m_marker_mm(marker_mm) {
+}
+StemCalibration CalibrationCache::lookup(const SensorPosition &position, const CalibrationData &data) {
+    const Key key = {position.height,position.tilt,position.rotation,data.m_server_path};
+    shared_ptr<Entry> entry;
+    {
+        lock_guard<mutex> lock(m_lock);
+        shared_ptr<Entry> &slot(m_entries[key]);
+        if(!slot)
+            slot = make_shared<Entry>();
+        entry = slot;
+    }
+    // the image is read and searched outside of the cache lock, until it gives a scale
+    lock_guard<mutex> lock(entry->lock);
+    if(!entry->calibration.valid()) {
+        entry->calibration = detectCalibration(imread(data.m_server_path),m_marker_mm);
+        if(!entry->calibration.valid())
+            fprintf(stderr,"%s: no calibration marker found, using the default scale\n",data.m_server_path.c_str());
+    }
+    return entry->calibration;
+}
+size_t CalibrationCache::size() const {
+    lock_guard<mutex> lock(m_lock);
+    return m_entries.size();
+}
+vector<StemResult> measureSensor(StemMeasurer &measurer, CalibrationCache &cache,
+                                 const SensorMeasurement &measurement) {
+    measurer.setCalibration(cache.lookup(measurement.m_capture_location,measurement.m_calibration));
+    vector<StemResult> results;
+    results.reserve(measurement.m_data.size());
+    for(const CaptureData &capture : measurement.m_data)
+        results.push_back(measurer.measureFile(capture.m_server_path));
+    return results;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "DataSet.h"
+#include "StemMeasurer.h"
+
+// Scale from the corners of a square marker with sides of marker_mm, given in order around it. Like px_per_mm of
+// image_processing/notebook/calculate_stem_thickness.py, but averaged over both diagonals of the marker.
+StemCalibration markerCalibration(const std::vector<cv::Point2f> &corners, float marker_mm);
+// Scale from the QR code in image. Not valid when there is none, or when OpenCV is older than 3.4.4 and has no
+// QR code detector; markerCalibration takes corners found by other means.
+StemCalibration detectCalibration(const cv::Mat &image, float marker_mm);
+
+// Calibration of every sensor position, detected from the calibration image of the position the first time it is
+// looked up and shared by every frame taken there. A lookup that can not read the image or finds no marker is not
+// kept, the next lookup of the position tries again. May be shared by the workers of one process; a position that is
+// being calibrated only holds up the lookups of the same position.
+class CalibrationCache
+{
+public:
+    explicit CalibrationCache(float marker_mm = StemParams().marker_mm);
+
+    // Not valid when the image of data can not be read or shows no marker, measurers then keep their default scale
+    StemCalibration lookup(const SensorPosition &position, const CalibrationData &data);
+    size_t          size() const;
+
+private:
+    struct Key
+    {
+        float       height, tilt, rotation;
+        std::string path;
+
+        bool operator<(const Key &o) const;
+    };
+    struct Entry
+    {
+        std::mutex      lock;
+        StemCalibration calibration; // only set once valid
+    };
+
+    float                                  m_marker_mm;
+    std::map<Key, std::shared_ptr<Entry>>  m_entries;
+    mutable std::mutex                     m_lock;
+};
+
+// Every frame of measurement, measured with the calibration of its sensor position
+std::vector<StemResult> measureSensor(StemMeasurer &measurer, CalibrationCache &cache,
+                                      const SensorMeasurement &measurement);
@@ -0,0 +1,41 @@
+#include "ColumnProfile.h"
+
+#include <algorithm>
+
+using namespace cv;
+
+void ColumnProfile::build(const Mat3b &pic, int min_diff) {
+    const int cols = pic.cols;
+    m_rows = pic.rows;
+    m_min_diff = min_diff;
+    m_sums.assign(size_t(3)*cols,0);
+    m_green_rows.assign(cols,0);
+    int *sums = m_sums.data();
+    int *green = m_green_rows.data();
+    for(int y=0; y<pic.rows; ++y) {
+        // plain loops over the row, both get vectorized by the compiler
+        const uchar *p = pic.ptr<uchar>(y);
+        for(int i=0; i<3*cols; ++i)
+            sums[i] += p[i];
+        for(int x=0; x<cols; ++x) {
+            int other = std::max(p[3*x],p[3*x+2]);
+            green[x] += p[3*x+1]>other+min_diff;
+        }
+    }
+    m_next_green.resize(cols+1);
+    m_next_green[cols] = cols;
+    for(int x=cols-1; x>=0; --x)
+        m_next_green[x] = green[x] ? x : m_next_green[x+1];
+    m_last_bare.resize(cols);
+    for(int x=0; x<cols; ++x)
+        m_last_bare[x] = !green[x] ? x : (x>0 ? m_last_bare[x-1] : -1);
+}
+bool ColumnProfile::meanIsGreen(int x) const {
+    if(m_rows==0)
+        return false;
+    // cv::mean scales the exact integer sums by 1/count
+    const double scale = 1./m_rows;
+    const int *s = &m_sums[3*x];
+    double max_other = std::max(s[0]*scale,s[2]*scale);
+    return s[1]*scale>max_other+m_min_diff;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Per column statistics of a 3-channel image gathered in a single row-major pass: channel sums, giving the column
+// means, and the number of rows whose middle channel exceeds both others by more than min_diff ( green pixels ).
+// Scans over these counts give the nearest column with or without green to either side in constant time.
+class ColumnProfile
+{
+public:
+    void build(const cv::Mat3b &pic, int min_diff = 2); // reuses the storage of the previous build
+
+    int  cols() const { return int(m_green_rows.size()); }
+    int  greenRows(int x) const { return m_green_rows[x]; }
+    bool hasGreen(int x) const { return m_green_rows[x] > 0; }
+    // Same decision as comparing the channels of cv::mean of the column
+    bool meanIsGreen(int x) const;
+    int  nextWithGreen(int x) const { return m_next_green[x]; }  // first column >= x with green, cols() if none
+    int  lastWithoutGreen(int x) const { return m_last_bare[x]; } // last column <= x without green, -1 if none
+
+private:
+    int              m_rows     = 0;
+    int              m_min_diff = 2;
+    std::vector<int> m_sums; // 3 per column, interleaved like the pixels
+    std::vector<int> m_green_rows;
+    std::vector<int> m_next_green; // cols+1 entries
+    std::vector<int> m_last_bare;
+};
@@ -0,0 +1,94 @@
+#include "DebugSink.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <cstdio>
+
+namespace {
+thread_local std::string t_image_tag;
+std::atomic<unsigned>    image_sequence{0};
+}
+
+DebugSink &DebugSink::instance() {
+    static DebugSink sink;
+    return sink;
+}
+DebugSink::~DebugSink() {
+    stop();
+}
+void DebugSink::start(const std::string &dir, int level, size_t max_queued) {
+    stop();
+    m_dir = dir.empty() ? std::string(".") : dir;
+    QDir().mkpath(QString::fromLocal8Bit(m_dir.c_str()));
+    m_max_queued = std::max<size_t>(1,max_queued);
+    m_stopping = false;
+    if(level>DEBUG_OFF)
+        m_writer = std::thread(&DebugSink::writerLoop,this);
+    m_level = level;
+}
+void DebugSink::stop() {
+    m_level = DEBUG_OFF;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stopping = true;
+    }
+    m_not_empty.notify_all();
+    m_not_full.notify_all();
+    if(m_writer.joinable())
+        m_writer.join();
+}
+void DebugSink::tap(const char *name, const cv::Mat &img) {
+    Item item;
+    item.path = m_dir + '/' + (t_image_tag.empty() ? std::string() : t_image_tag + '_') + name + ".png";
+    item.img = img.clone(); // caller is free to reuse its buffer
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_not_full.wait(guard,[this] { return m_stopping || m_queue.size()<m_max_queued; });
+    if(m_stopping)
+        return;
+    m_queue.push_back(std::move(item));
+    m_not_empty.notify_one();
+}
+void DebugSink::writerLoop() {
+    std::unique_lock<std::mutex> guard(m_lock);
+    for(;;) {
+        m_not_empty.wait(guard,[this] { return m_stopping || !m_queue.empty(); });
+        if(m_queue.empty())
+            return; // stopping and drained
+        Item item = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_not_full.notify_one();
+        guard.unlock();
+        cv::imwrite(item.path,item.img);
+        m_written++;
+        guard.lock();
+    }
+}
+
+DebugImageScope::DebugImageScope(const std::string &image_path) : m_prev(t_image_tag) {
+    // images of the same name from other directories or laps are told apart by the directory and a sequence number
+    std::string dir;
+    size_t slash = image_path.find_last_of("/\\");
+    if(slash!=std::string::npos && slash>0) {
+        size_t from = image_path.find_last_of("/\\",slash-1);
+        from = from==std::string::npos ? 0 : from+1;
+        dir = image_path.substr(from,slash-from);
+    }
+    char seq[16];
+    snprintf(seq,sizeof(seq),"_%06u",image_sequence++);
+    t_image_tag = (dir.empty() || dir=="." ? std::string() : dir+'_') +
+                  QFileInfo(QString::fromLocal8Bit(image_path.c_str())).completeBaseName().toLocal8Bit().constData() +
+                  seq;
+}
+DebugImageScope::DebugImageScope(const std::string &tag, const char *part, int index) : m_prev(t_image_tag) {
+    char suffix[32];
+    snprintf(suffix,sizeof(suffix),"%s%d",part,index);
+    t_image_tag = tag.empty() ? std::string(suffix) : tag+'_'+suffix;
+}
+DebugImageScope::~DebugImageScope() {
+    t_image_tag = m_prev;
+}
+std::string DebugImageScope::currentTag() {
+    return t_image_tag;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <opencv2/core/core.hpp>
+
+enum DebugLevel
+{
+    DEBUG_OFF    = 0,
+    DEBUG_RESULT = 1, // final overlays only
+    DEBUG_STAGES = 2, // intermediate images of each pipeline stage
+    DEBUG_ALL    = 3, // everything, including per-call inputs
+};
+
+// Collects debug images from the measurement pipeline and encodes them on a background thread.
+// Disabled by default, a disabled tap costs the initialization check of the function static instance() and a
+// relaxed atomic load.
+class DebugSink
+{
+public:
+    static DebugSink &instance();
+    ~DebugSink();
+
+    void   start(const std::string &dir, int level, size_t max_queued = 32);
+    void   stop(); // waits until all queued images are written
+    bool   enabled(int level) const { return level <= m_level.load(std::memory_order_relaxed); }
+    void   tap(const char *name, const cv::Mat &img);
+    size_t written() const { return m_written; }
+
+private:
+    struct Item
+    {
+        std::string path;
+        cv::Mat     img;
+    };
+    DebugSink() : m_level(DEBUG_OFF) {}
+    void writerLoop();
+
+    std::atomic<int>        m_level;
+    std::string             m_dir;
+    size_t                  m_max_queued = 0;
+    std::deque<Item>        m_queue;
+    std::mutex              m_lock;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+    std::thread             m_writer;
+    bool                    m_stopping = false;
+    std::atomic<size_t>     m_written{0};
+};
+
+// Sets the file name prefix used for taps made by the current thread, so parallel runs do not overwrite each other.
+// The prefix is the parent directory and base name of image_path with a sequence number of the process.
+class DebugImageScope
+{
+public:
+    explicit DebugImageScope(const std::string &image_path);
+    // For work on one image split over threads: the prefix is tag, taken with currentTag() on the thread that split
+    // the work, followed by part and index
+    DebugImageScope(const std::string &tag, const char *part, int index);
+    ~DebugImageScope();
+
+    // Prefix of the taps made by the current thread, empty outside of any scope
+    static std::string currentTag();
+
+private:
+    std::string m_prev;
+};
+
+#define DEBUG_TAP(level, name, img)                                                                                    \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (DebugSink::instance().enabled(level))                                                                      \
+            DebugSink::instance().tap(name, img);                                                                      \
+    } while (0)
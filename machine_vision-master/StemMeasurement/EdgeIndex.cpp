@@ -0,0 +1,45 @@
+#include "EdgeIndex.h"
+#include "EdgeRuns.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cv;
+
+void EdgeIndex::build(const Mat1b &edges) {
+    m_rows = edges.rows;
+    m_cols = edges.cols;
+    m_offsets.resize(m_rows+1);
+    m_xs.clear();
+    for(int y=0; y<m_rows; ++y) {
+        m_offsets[y] = int(m_xs.size());
+        const uchar *row = edges.ptr<uchar>(y);
+        for(int x=nextNonZero(row,0,m_cols); x<m_cols; x=nextNonZero(row,x+1,m_cols))
+            m_xs.push_back(x);
+    }
+    m_offsets[m_rows] = int(m_xs.size());
+}
+int EdgeIndex::nextRight(int x, int y, int maxX) const {
+    const int *first = m_xs.data()+m_offsets[y];
+    const int *last = m_xs.data()+m_offsets[y+1];
+    const int *it = std::lower_bound(first,last,x);
+    if(it==last || *it>=std::min(m_cols,maxX))
+        return m_cols;
+    return *it;
+}
+int EdgeIndex::nextLeft(int x, int y, int minX) const {
+    const int *first = m_xs.data()+m_offsets[y];
+    const int *last = m_xs.data()+m_offsets[y+1];
+    const int *it = std::upper_bound(first,last,x);
+    if(it==first || *(it-1)<=std::max(0,minX))
+        return 0;
+    return *(it-1);
+}
+Vec4f LineAccumulator::line() const {
+    if(n==0)
+        return Vec4f(0,1,0,0);
+    double denom = n*syy-sy*sy;
+    double slope = denom!=0 ? (n*sxy-sx*sy)/denom : 0;
+    double len = std::sqrt(slope*slope+1);
+    return Vec4f(float(slope/len),float(1/len),float(sx/n),float(sy/n));
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Sorted x positions of the edge pixels of every row of a binary edge image (CSR layout), so that finding the
+// nearest edge to either side of a point is a binary search instead of a walk over the row.
+class EdgeIndex
+{
+public:
+    void build(const cv::Mat1b &edges); // reuses the storage of the previous build
+
+    int rows() const { return m_rows; }
+    int cols() const { return m_cols; }
+    int edgesInRow(int y) const { return m_offsets[y + 1] - m_offsets[y]; }
+    // Same results as walking the row: first edge in [x,maxX) or cols, last edge in (max(minX,0),x] or 0
+    int nextRight(int x, int y, int maxX) const;
+    int nextLeft(int x, int y, int minX) const;
+
+private:
+    int              m_rows = 0;
+    int              m_cols = 0;
+    std::vector<int> m_offsets; // rows+1 entries, row y occupies m_xs[m_offsets[y],m_offsets[y+1])
+    std::vector<int> m_xs;
+};
+
+// Least-squares fit of x = a*y + b over points added one at a time, suited to near vertical lines
+struct LineAccumulator
+{
+    int    n   = 0;
+    double sx  = 0;
+    double sy  = 0;
+    double syy = 0;
+    double sxy = 0;
+
+    void add(double x, double y) {
+        ++n;
+        sx += x;
+        sy += y;
+        syy += y * y;
+        sxy += x * y;
+    }
+    // (vx, vy, x0, y0) like cv::fitLine, the direction points towards growing y and is normalized
+    cv::Vec4f line() const;
+};
@@ -0,0 +1,51 @@
+#include "EdgeRuns.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+static const int BLOCK = 32;
+static inline unsigned nonZeroBits(const uchar *p) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    return ~unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v,_mm256_setzero_si256())));
+}
+#elif defined(__SSE2__)
+static const int BLOCK = 16;
+static inline unsigned nonZeroBits(const uchar *p) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    return ~unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v,_mm_setzero_si128()))) & 0xFFFFu;
+}
+#endif
+
+int nextNonZero(const uchar *row, int from, int to) {
+    int x=from;
+#if defined(__AVX2__) || defined(__SSE2__)
+    for(; x+BLOCK<=to; x+=BLOCK) {
+        unsigned bits = nonZeroBits(row+x);
+        if(bits)
+            return x+__builtin_ctz(bits);
+    }
+#endif
+    for(; x<to; ++x)
+        if(row[x])
+            return x;
+    return to;
+}
+int prevNonZero(const uchar *row, int from, int stop) {
+    int x=from;
+#if defined(__AVX2__) || defined(__SSE2__)
+    // blocks end at x, so they cover row[x-BLOCK+1..x]
+    for(; x-BLOCK>=stop; x-=BLOCK) {
+        unsigned bits = nonZeroBits(row+x-BLOCK+1);
+        if(bits)
+            return x-BLOCK+1+(31-__builtin_clz(bits));
+    }
+#endif
+    for(; x>stop; --x)
+        if(row[x])
+            return x;
+    return stop;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Position of the first non zero byte in row[from,to), to when there is none
+int nextNonZero(const uchar *row, int from, int to);
+// Position of the last non zero byte in row(stop,from], stop when there is none
+int prevNonZero(const uchar *row, int from, int stop);
+
+struct EdgeRun
+{
+    int row;
+    int start; // left edge
+    int end;   // right edge
+};
+
+// Finds pairs of consecutive edges in a binary edge image whose distance lies in (MIN_WIDTH,MAX_WIDTH). A run
+// that is not accepted restarts the search at its right edge, an accepted one after it. The right edge is looked
+// for at most MAX_GAP pixels away, and scanning of a row stops when no right edge is left in it.
+template <int MIN_WIDTH, int MAX_WIDTH, int MAX_GAP = 100>
+struct EdgeRunScanner
+{
+    static_assert(MIN_WIDTH >= 4, "runs narrower than 5 pixels are always rejected");
+    static_assert(MIN_WIDTH < MAX_WIDTH && MAX_WIDTH <= MAX_GAP + 1, "empty width window");
+    enum { min_width = MIN_WIDTH, max_width = MAX_WIDTH };
+
+    static void scanRow(const uchar *row, int cols, std::vector<std::pair<int, int>> &runs) {
+        int i = nextNonZero(row,0,cols);
+        while(i<cols) {
+            int end = nextNonZero(row,i+1,std::min(cols,i+MAX_GAP+1));
+            if(end==cols)
+                break;
+            int width = end-i;
+            if(width>MIN_WIDTH && width<MAX_WIDTH) {
+                runs.push_back(std::make_pair(i,end));
+                ++end;
+            }
+            i = nextNonZero(row,end,cols);
+        }
+    }
+    static std::vector<std::pair<int, int>> scanRow(const cv::Mat1b &edges, int row) {
+        std::vector<std::pair<int, int>> runs;
+        scanRow(edges.ptr<uchar>(row),edges.cols,runs);
+        return runs;
+    }
+    // Runs of rows first..last (inclusive, either direction), grouped by row in scanning order
+    static void scanRows(const cv::Mat1b &edges, int first, int last, std::vector<EdgeRun> &runs) {
+        std::vector<std::pair<int, int>> row_runs;
+        int step = first<=last ? 1 : -1;
+        for(int y=first; y!=last+step; y+=step) {
+            row_runs.clear();
+            scanRow(edges.ptr<uchar>(y),edges.cols,row_runs);
+            for(const std::pair<int, int> &r : row_runs) {
+                EdgeRun run = {y,r.first,r.second};
+                runs.push_back(run);
+            }
+        }
+    }
+    // First row of [first,last) having runs, -1 when none does
+    static int firstRowWithRuns(const cv::Mat1b &edges, int first, int last, std::vector<std::pair<int, int>> &runs) {
+        for(int y=first; y<last; ++y) {
+            runs.clear();
+            scanRow(edges.ptr<uchar>(y),edges.cols,runs);
+            if(!runs.empty())
+                return y;
+        }
+        return -1;
+    }
+};
+
+typedef EdgeRunScanner<4, 15>  WireRunScanner; // hanging wire seen from the front
+typedef EdgeRunScanner<25, 90> StemRunScanner;
@@ -0,0 +1,197 @@
+#include "FastMorphology.h"
+
+#include <algorithm>
+#include <cstring>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace cv;
+
+namespace {
+struct MaxOp
+{
+    static uchar neutral() { return 0; }
+    static uchar apply(uchar a, uchar b) { return std::max(a,b); }
+#if defined(__SSE2__)
+    static __m128i apply(__m128i a, __m128i b) { return _mm_max_epu8(a,b); }
+#endif
+};
+struct MinOp
+{
+    static uchar neutral() { return 255; }
+    static uchar apply(uchar a, uchar b) { return std::min(a,b); }
+#if defined(__SSE2__)
+    static __m128i apply(__m128i a, __m128i b) { return _mm_min_epu8(a,b); }
+#endif
+};
+template<class Op>
+void rowOp(const uchar *a, const uchar *b, uchar *out, int n) {
+    int x=0;
+#if defined(__SSE2__)
+    for(; x+16<=n; x+=16) {
+        __m128i r = Op::apply(_mm_loadu_si128((const __m128i *)(a+x)),_mm_loadu_si128((const __m128i *)(b+x)));
+        _mm_storeu_si128((__m128i *)(out+x),r);
+    }
+#endif
+    for(; x<n; ++x)
+        out[x] = Op::apply(a[x],b[x]);
+}
+}
+FastMorphology::FastMorphology(const Mat &element) {
+    setElement(element);
+}
+void FastMorphology::setElement(const Mat &element) {
+    m_element = element;
+    m_rects.clear();
+    if(element.empty() || element.type()!=CV_8UC1 || element.cols%2==0 || element.rows%2==0)
+        return;
+    const int cx = element.cols/2;
+    const int cy = element.rows/2;
+    std::vector<int> half(cy+1);
+    for(int dy=0; dy<=cy; ++dy) {
+        for(int y : {cy-dy,cy+dy}) {
+            const uchar *row = element.ptr<uchar>(y);
+            int first = 0;
+            while(first<element.cols && !row[first])
+                ++first;
+            int last = element.cols-1;
+            while(last>=first && !row[last])
+                --last;
+            if(first>last || first!=2*cx-last || std::count(row+first,row+last+1,0)!=0)
+                return; // empty, off centre or with holes
+            half[dy] = cx-first;
+        }
+        if(dy>0 && half[dy]>half[dy-1])
+            return;
+        if(std::memcmp(element.ptr<uchar>(cy-dy),element.ptr<uchar>(cy+dy),element.cols)!=0)
+            return;
+    }
+    std::vector<Size> rects;
+    for(int dy=0; dy<=cy; ++dy) {
+        if(dy==cy || half[dy+1]!=half[dy])
+            rects.push_back(Size(half[dy],dy));
+    }
+    m_rects.swap(rects);
+}
+template<class Op>
+void FastMorphology::horizontal(const Mat &src, Mat &dst, int radius) {
+    // running min/max over [x-radius,x+radius] of every row, channels are filtered independently
+    const int cn = src.channels();
+    const int k = 2*radius+1;
+    const int padded = src.cols+2*radius;
+    m_row.resize(size_t(3)*padded*cn);
+    uchar *p = &m_row[0];
+    uchar *prefix = p+padded*cn;
+    uchar *suffix = prefix+padded*cn;
+    std::fill(p,p+radius*cn,Op::neutral());
+    std::fill(p+(radius+src.cols)*cn,p+padded*cn,Op::neutral());
+    dst.create(src.size(),src.type());
+    for(int y=0; y<src.rows; ++y) {
+        std::memcpy(p+radius*cn,src.ptr<uchar>(y),src.cols*cn);
+        for(int i=0, in_block=0; i<padded; ++i, in_block = in_block+1==k ? 0 : in_block+1) {
+            for(int c=0; c<cn; ++c)
+                prefix[i*cn+c] = in_block==0 ? p[i*cn+c] : Op::apply(prefix[(i-1)*cn+c],p[i*cn+c]);
+        }
+        for(int i=padded-1; i>=0; --i) {
+            bool block_end = i%k==k-1 || i==padded-1;
+            for(int c=0; c<cn; ++c)
+                suffix[i*cn+c] = block_end ? p[i*cn+c] : Op::apply(suffix[(i+1)*cn+c],p[i*cn+c]);
+        }
+        rowOp<Op>(suffix,prefix+2*radius*cn,dst.ptr<uchar>(y),src.cols*cn);
+    }
+}
+template<class Op>
+void FastMorphology::vertical(const Mat &src, Mat &dst, int radius) {
+    // the same over [y-radius,y+radius], whole rows at a time
+    const int k = 2*radius+1;
+    const int padded = src.rows+2*radius;
+    const int bytes = src.cols*src.channels();
+    m_row.assign(bytes,Op::neutral());
+    const uchar *neutral = &m_row[0];
+    m_prefix.create(padded,bytes,CV_8UC1);
+    m_suffix.create(padded,bytes,CV_8UC1);
+    dst.create(src.size(),src.type());
+    for(int i=0; i<padded; ++i) {
+        const uchar *p = (i<radius || i>=radius+src.rows) ? neutral : src.ptr<uchar>(i-radius);
+        if(i%k==0)
+            std::memcpy(m_prefix.ptr<uchar>(i),p,bytes);
+        else
+            rowOp<Op>(m_prefix.ptr<uchar>(i-1),p,m_prefix.ptr<uchar>(i),bytes);
+    }
+    for(int i=padded-1; i>=0; --i) {
+        const uchar *p = (i<radius || i>=radius+src.rows) ? neutral : src.ptr<uchar>(i-radius);
+        if(i%k==k-1 || i==padded-1)
+            std::memcpy(m_suffix.ptr<uchar>(i),p,bytes);
+        else
+            rowOp<Op>(m_suffix.ptr<uchar>(i+1),p,m_suffix.ptr<uchar>(i),bytes);
+    }
+    for(int y=0; y<src.rows; ++y)
+        rowOp<Op>(m_suffix.ptr<uchar>(y),m_prefix.ptr<uchar>(y+2*radius),dst.ptr<uchar>(y),bytes);
+}
+template<class Op>
+void FastMorphology::filter(const Mat &src, Mat &dst) {
+    // src must not share memory with dst
+    dst.create(src.size(),src.type());
+    const int bytes = src.cols*src.channels();
+    for(size_t r=0; r<m_rects.size(); ++r) {
+        const Size &half(m_rects[r]);
+        const Mat *res = &src;
+        if(half.width>0) {
+            horizontal<Op>(*res,m_line,half.width);
+            res = &m_line;
+        }
+        if(half.height>0) {
+            vertical<Op>(*res,r==0 ? dst : m_rect,half.height);
+            res = r==0 ? &dst : &m_rect;
+        }
+        if(r==0) {
+            if(res!=&dst)
+                res->copyTo(dst);
+            continue;
+        }
+        for(int y=0; y<dst.rows; ++y)
+            rowOp<Op>(dst.ptr<uchar>(y),res->ptr<uchar>(y),dst.ptr<uchar>(y),bytes);
+    }
+}
+void FastMorphology::apply(const Mat &src, Mat &dst, int op) {
+    bool supported = op==MORPH_ERODE || op==MORPH_DILATE || op==MORPH_OPEN || op==MORPH_CLOSE;
+    if(!decomposed() || !supported || src.empty() || src.depth()!=CV_8U || (src.channels()!=1 && src.channels()!=3)) {
+        morphologyEx(src,dst,op,m_element);
+        return;
+    }
+    // as in cv::morphologyEx, a ROI reads the pixels of its image under the element and the border only starts at
+    // the edge of the whole image: the first pass runs on src grown by the element, clamped to the image
+    Size whole;
+    Point ofs;
+    src.locateROI(whole,ofs);
+    const int rx = m_element.cols/2, ry = m_element.rows/2;
+    const int top = std::min(ry,ofs.y), bottom = std::min(ry,whole.height-ofs.y-src.rows);
+    const int left = std::min(rx,ofs.x), right = std::min(rx,whole.width-ofs.x-src.cols);
+    const bool grown = top>0 || bottom>0 || left>0 || right>0;
+    Mat in = src;
+    if(grown)
+        in.adjustROI(top,bottom,left,right);
+    else if(dst.data && dst.datastart==src.datastart) {
+        src.copyTo(m_input);
+        in = m_input;
+    }
+    const bool single = op==MORPH_ERODE || op==MORPH_DILATE;
+    Mat &first(single && !grown ? dst : m_first);
+    if(op==MORPH_ERODE || op==MORPH_OPEN)
+        filter<MinOp>(in,first);
+    else
+        filter<MaxOp>(in,first);
+    // the second pass reads only the result of the first, like the temporary image of cv::morphologyEx
+    const Mat first_src = grown ? first(Rect(left,top,src.cols,src.rows)) : first;
+    switch(op) {
+        case MORPH_OPEN: filter<MaxOp>(first_src,dst); break;
+        case MORPH_CLOSE: filter<MinOp>(first_src,dst); break;
+        default:
+            if(grown)
+                first_src.copyTo(dst);
+            break;
+    }
+}
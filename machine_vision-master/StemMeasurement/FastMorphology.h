@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Erosion/dilation with a symmetric structuring element whose rows are centred spans getting narrower away from
+// the middle row (ellipses, crosses, rectangles). Such an element is the union of a few centred rectangles, each
+// applied as a horizontal and a vertical van Herk/Gil-Werman running min/max, so the cost per pixel does not
+// depend on the length of the lines. Results equal cv::morphologyEx with the default anchor and border, ROIs
+// included: the pixels of the parent image under the element are read, the constant border starts at the edge of
+// the whole image. Other elements, images that are not 8-bit with 1 or 3 channels, and unsupported operations go to
+// cv::morphologyEx.
+class FastMorphology
+{
+public:
+    explicit FastMorphology(const cv::Mat &element = cv::Mat());
+
+    void setElement(const cv::Mat &element);
+    const cv::Mat &element() const { return m_element; }
+    bool decomposed() const { return !m_rects.empty(); }
+    // op is one of MORPH_ERODE, MORPH_DILATE, MORPH_OPEN, MORPH_CLOSE
+    void apply(const cv::Mat &src, cv::Mat &dst, int op);
+
+private:
+    template <class Op> void filter(const cv::Mat &src, cv::Mat &dst);
+    template <class Op> void horizontal(const cv::Mat &src, cv::Mat &dst, int radius);
+    template <class Op> void vertical(const cv::Mat &src, cv::Mat &dst, int radius);
+
+    cv::Mat               m_element;
+    std::vector<cv::Size> m_rects; // half width and half height of the rectangles making up the element
+    // scratch buffers, kept between calls
+    cv::Mat              m_input;
+    cv::Mat              m_first;
+    cv::Mat              m_line;
+    cv::Mat              m_rect;
+    cv::Mat              m_prefix;
+    cv::Mat              m_suffix;
+    std::vector<uchar>   m_row;
+};
@@ -0,0 +1,101 @@
+#include "FusedEqualize.h"
+
+#include <algorithm>
+
+using namespace cv;
+
+namespace {
+// fixed point tables of OpenCV's RGB2HSV_b and RGB2Gray<uchar>
+const int HSV_SHIFT = 12;
+const int GRAY_SHIFT = 14;
+const int R2Y = 4899, G2Y = 9617, B2Y = 1868;
+
+struct HsvTables
+{
+    int sdiv[256];
+    int hdiv[256]; // hue range 256, the _FULL conversions
+    HsvTables() {
+        sdiv[0] = hdiv[0] = 0;
+        for(int i=1; i<256; ++i) {
+            sdiv[i] = saturate_cast<int>((255 << HSV_SHIFT)/(1.*i));
+            hdiv[i] = saturate_cast<int>((256 << HSV_SHIFT)/(6.*i));
+        }
+    }
+};
+const HsvTables &hsvTables() {
+    static HsvTables tables;
+    return tables;
+}
+}
+
+void valueHistogram(const Mat &rgb, int *hist) {
+    CV_Assert(rgb.type()==CV_8UC3);
+    for(int y=0; y<rgb.rows; ++y) {
+        const uchar *p = rgb.ptr<uchar>(y);
+        for(int x=0; x<rgb.cols; ++x, p+=3)
+            hist[std::max(p[0],std::max(p[1],p[2]))]++;
+    }
+}
+void equalizeRgb(const Mat &rgb, const Mat &lut, Mat &rgb_equalized, Mat &gray, Mat *hsv_equalized) {
+    CV_Assert(rgb.type()==CV_8UC3 && lut.type()==CV_8UC1 && lut.total()==256 && lut.isContinuous());
+    rgb_equalized.create(rgb.size(),CV_8UC3);
+    gray.create(rgb.size(),CV_8UC1);
+    if(hsv_equalized)
+        hsv_equalized->create(rgb.size(),CV_8UC3);
+    const HsvTables &t(hsvTables());
+    const uchar *l = lut.ptr<uchar>(0);
+    // the sector tables of HSV2RGB_f, index 3 is v
+    static const int sector_data[6][3] = {{1,3,0},{1,0,2},{3,0,1},{0,2,1},{0,1,3},{2,1,0}};
+    for(int y=0; y<rgb.rows; ++y) {
+        const uchar *src = rgb.ptr<uchar>(y);
+        uchar *out = rgb_equalized.ptr<uchar>(y);
+        uchar *g = gray.ptr<uchar>(y);
+        uchar *hsv = hsv_equalized ? hsv_equalized->ptr<uchar>(y) : nullptr;
+        for(int x=0; x<rgb.cols; ++x, src+=3, out+=3) {
+            // RGB2HSV_b, red first
+            int r = src[0], gr = src[1], b = src[2];
+            int v = std::max(r,std::max(gr,b));
+            int vmin = std::min(r,std::min(gr,b));
+            int diff = v-vmin;
+            int vr = v==r ? -1 : 0, vg = v==gr ? -1 : 0;
+            int s = (diff*t.sdiv[v]+(1 << (HSV_SHIFT-1))) >> HSV_SHIFT;
+            int h = (vr & (gr-b))+(~vr & ((vg & (b-r+2*diff))+((~vg) & (r-gr+4*diff))));
+            h = (h*t.hdiv[diff]+(1 << (HSV_SHIFT-1))) >> HSV_SHIFT;
+            h += h<0 ? 256 : 0;
+            const uchar hue = saturate_cast<uchar>(h);
+            const uchar value = l[v];
+            if(hsv) {
+                hsv[0] = hue;
+                hsv[1] = uchar(s);
+                hsv[2] = value;
+                hsv += 3;
+            }
+            // HSV2RGB_b: to float, HSV2RGB_f, back to 8 bits
+            float fs = s*(1.f/255.f), fv = value*(1.f/255.f);
+            float fb, fg, fr;
+            if(fs==0)
+                fb = fg = fr = fv;
+            else {
+                float fh = hue*(6.f/256.f);
+                int sector = cvFloor(fh);
+                fh -= sector;
+                if((unsigned)sector>=6u) {
+                    sector = 0;
+                    fh = 0.f;
+                }
+                float tab[4];
+                tab[0] = fv;
+                tab[1] = fv*(1.f-fs);
+                tab[2] = fv*(1.f-fs*fh);
+                tab[3] = fv*(1.f-fs*(1.f-fh));
+                fb = tab[sector_data[sector][0]];
+                fg = tab[sector_data[sector][1]];
+                fr = tab[sector_data[sector][2]];
+            }
+            out[0] = saturate_cast<uchar>(fr*255.f);
+            out[1] = saturate_cast<uchar>(fg*255.f);
+            out[2] = saturate_cast<uchar>(fb*255.f);
+            g[x] = uchar((out[0]*R2Y+out[1]*G2Y+out[2]*B2Y+(1 << (GRAY_SHIFT-1))) >> GRAY_SHIFT);
+        }
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <opencv2/core/core.hpp>
+
+// Adds the histogram of V ( the largest channel, as CV_RGB2HSV_FULL computes it ) of a CV_8UC3 image to hist[256]
+void valueHistogram(const cv::Mat &rgb, int *hist);
+
+// V equalization of an RGB image in a single pass, without HSV planes: every pixel is converted to H, S and V as
+// CV_RGB2HSV_FULL does, V goes through lut, and the pixel is converted back as CV_HSV2RGB_FULL does and to gray as
+// CV_RGB2GRAY does. Gives the same pixels as cvtColor, split, LUT or equalizeHist, merge and the two cvtColor calls
+// back of OpenCV's 8-bit conversions. The equalized HSV pixels are written too when hsv is given.
+void equalizeRgb(const cv::Mat &rgb, const cv::Mat &lut, cv::Mat &rgb_equalized, cv::Mat &gray,
+                 cv::Mat *hsv_equalized = nullptr);
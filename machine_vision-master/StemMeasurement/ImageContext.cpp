@@ -0,0 +1,206 @@
+#include "ImageContext.h"
+#include "FusedEqualize.h"
+#include "StemWorkspace.h"
+
+#include <algorithm>
+#include <vector>
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace cv;
+
+static WorkspaceSlot slotFor(ImagePlane p, bool window) {
+    if(window) {
+        switch(p) {
+            case PLANE_HSV_FULL: return WS_WINDOW_HSV;
+            case PLANE_H: return WS_WINDOW_HSV_PLANE0;
+            case PLANE_S: return WS_WINDOW_HSV_PLANE1;
+            case PLANE_V: return WS_WINDOW_HSV_PLANE2;
+            case PLANE_HSV: return WS_WINDOW_HSV_180;
+            case PLANE_GRAY_BLURRED: return WS_WINDOW_GRAY_BLURRED;
+            case PLANE_EDGES: return WS_WINDOW_EDGES;
+            default: break; // the frame level planes are always views into the parent
+        }
+        return WS_SLOT_COUNT;
+    }
+    switch(p) {
+        case PLANE_HSV_FULL: return WS_HSV;
+        case PLANE_H: return WS_HSV_PLANE0;
+        case PLANE_S: return WS_HSV_PLANE1;
+        case PLANE_V: return WS_HSV_PLANE2;
+        case PLANE_HSV: return WS_HSV_180;
+        case PLANE_V_EQUALIZED: return WS_V_EQUALIZED;
+        case PLANE_HSV_EQUALIZED: return WS_HSV_EQUALIZED;
+        case PLANE_RGB_EQUALIZED: return WS_RGB_EQUALIZED;
+        case PLANE_GRAY_EQUALIZED: return WS_GRAY;
+        case PLANE_GRAY_BLURRED: return WS_GRAY_BLURRED;
+        case PLANE_EDGES: return WS_EDGES;
+        default: break;
+    }
+    return WS_SLOT_COUNT;
+}
+static bool isFrameLevel(ImagePlane p) {
+    // these depend on statistics of the whole frame, so a sub-area must never compute its own
+    return p==PLANE_V_EQUALIZED || p==PLANE_HSV_EQUALIZED || p==PLANE_RGB_EQUALIZED || p==PLANE_GRAY_EQUALIZED;
+}
+ImageContext::ImageContext(const Mat &base, StemWorkspace *ws) : m_base(base), m_ws(ws) {
+    std::fill(m_valid,m_valid+PLANE_COUNT,false);
+}
+void ImageContext::reset(const Mat &base) {
+    m_base = base;
+    m_parent = nullptr;
+    m_canny_param = -1;
+    m_lut.release();
+    std::fill(m_valid,m_valid+PLANE_COUNT,false);
+}
+void ImageContext::setEqualization(const Mat &lut) {
+    m_lut = lut;
+    m_valid[PLANE_V_EQUALIZED] = m_valid[PLANE_HSV_EQUALIZED] = false;
+    m_valid[PLANE_RGB_EQUALIZED] = m_valid[PLANE_GRAY_EQUALIZED] = false;
+    m_valid[PLANE_GRAY_BLURRED] = m_valid[PLANE_EDGES] = false;
+}
+void ImageContext::setPlane(ImagePlane p, const Mat &m) {
+    CV_Assert(m.size()==size());
+    m_planes[p] = m;
+    m_valid[p] = true;
+}
+ImageContext ImageContext::roi(const Rect &r, StemWorkspace *ws) {
+    ImageContext child(m_base(r),ws);
+    child.m_parent = this;
+    child.m_rect = r;
+    return child;
+}
+const Mat &ImageContext::edges(int canny_param) {
+    if(m_canny_param!=canny_param) {
+        m_canny_param = canny_param;
+        m_valid[PLANE_EDGES] = false;
+    }
+    return plane(PLANE_EDGES);
+}
+const Mat &ImageContext::plane(ImagePlane p) {
+    if(m_valid[p])
+        return m_planes[p];
+    bool parent_has = m_parent && m_parent->m_valid[p] &&
+                      (p!=PLANE_EDGES || m_parent->m_canny_param==m_canny_param);
+    if(m_parent && (parent_has || isFrameLevel(p))) {
+        if(p==PLANE_EDGES)
+            m_parent->m_canny_param = m_canny_param;
+        m_planes[p] = m_parent->plane(p)(m_rect);
+    }
+    else
+        compute(p);
+    m_valid[p] = true;
+    return m_planes[p];
+}
+const Mat &ImageContext::equalization() {
+    if(m_parent)
+        return m_parent->equalization();
+    if(m_lut.empty()) {
+        int hist[256] = {0};
+        valueHistogram(m_base,hist);
+        Mat &lut(m_ws ? m_ws->mat(WS_EQUALIZATION_LUT,Size(256,1),CV_8UC1) : m_frame_lut);
+        equalizationLut(hist,int(m_base.total()),lut);
+        // the LUT equalizeHist would derive, so the planes computed so far stay valid
+        m_lut = lut;
+    }
+    return m_lut;
+}
+Mat &ImageContext::target(ImagePlane p, int type) {
+    if(m_ws)
+        return m_ws->mat(slotFor(p,m_parent!=nullptr),size(),type);
+    m_planes[p].create(size(),type);
+    return m_planes[p];
+}
+void ImageContext::compute(ImagePlane p) {
+    switch(p) {
+        case PLANE_HSV_FULL: {
+            Mat &t(target(p,CV_8UC3));
+            cvtColor(m_base,t,CV_RGB2HSV_FULL);
+            m_planes[p] = t;
+            break;
+        }
+        case PLANE_H:
+        case PLANE_S:
+        case PLANE_V: {
+            std::vector<Mat> local(m_planes+PLANE_H,m_planes+PLANE_H+3);
+            std::vector<Mat> &channels(m_ws ? m_ws->planes(slotFor(PLANE_H,m_parent!=nullptr),size(),CV_8U,3)
+                                            : local);
+            split(hsvFull(),channels);
+            for(int i=0; i<3; ++i) {
+                m_planes[PLANE_H+i] = channels[i];
+                m_valid[PLANE_H+i] = true;
+            }
+            break;
+        }
+        case PLANE_HSV: {
+            Mat &t(target(p,CV_8UC3));
+            cvtColor(m_base,t,CV_RGB2HSV);
+            m_planes[p] = t;
+            break;
+        }
+        case PLANE_V_EQUALIZED: {
+            Mat &t(target(p,CV_8UC1));
+            LUT(hsvPlane(2),equalization(),t);
+            m_planes[p] = t;
+            break;
+        }
+        case PLANE_HSV_EQUALIZED:
+        case PLANE_RGB_EQUALIZED:
+        case PLANE_GRAY_EQUALIZED: {
+            // one pass over the base image gives all three, no HSV planes in between
+            const Mat &lut(equalization());
+            Mat &hsv_t(target(PLANE_HSV_EQUALIZED,CV_8UC3));
+            Mat &rgb_t(target(PLANE_RGB_EQUALIZED,CV_8UC3));
+            Mat &gray_t(target(PLANE_GRAY_EQUALIZED,CV_8UC1));
+            equalizeRgb(m_base,lut,rgb_t,gray_t,&hsv_t);
+            m_planes[PLANE_HSV_EQUALIZED] = hsv_t;
+            m_planes[PLANE_RGB_EQUALIZED] = rgb_t;
+            m_planes[PLANE_GRAY_EQUALIZED] = gray_t;
+            m_valid[PLANE_HSV_EQUALIZED] = m_valid[PLANE_RGB_EQUALIZED] = m_valid[PLANE_GRAY_EQUALIZED] = true;
+            break;
+        }
+        case PLANE_GRAY_BLURRED: {
+            Mat &t(target(p,CV_8UC1));
+            blur(equalizedGray(),t,Size(3,3));
+            m_planes[p] = t;
+            break;
+        }
+        case PLANE_EDGES: {
+            Mat &t(target(p,CV_8UC1));
+            Canny(blurredGray(),t,m_canny_param,m_canny_param*3,3,true);
+            m_planes[p] = t;
+            break;
+        }
+        default:
+            break;
+    }
+}
+void equalizationLut(const Mat &gray, Mat &lut) {
+    // same mapping as cv::equalizeHist: the darkest present value goes to 0, the rest by the cumulative histogram
+    int hist[256] = {0};
+    for(int y=0; y<gray.rows; ++y) {
+        const uchar *p = gray.ptr<uchar>(y);
+        for(int x=0; x<gray.cols; ++x)
+            hist[p[x]]++;
+    }
+    equalizationLut(hist,int(gray.total()),lut);
+}
+void equalizationLut(const int *hist, int total, Mat &lut) {
+    lut.create(1,256,CV_8UC1);
+    uchar *l = lut.ptr<uchar>(0);
+    std::fill(l,l+256,0);
+    int i = 0;
+    while(i<256 && !hist[i])
+        ++i;
+    if(i==256)
+        return;
+    if(hist[i]==total) {
+        std::fill(l,l+256,uchar(i));
+        return;
+    }
+    float scale = 255.f/(total-hist[i]);
+    int sum = 0;
+    for(l[i++]=0; i<256; ++i) {
+        sum += hist[i];
+        l[i] = saturate_cast<uchar>(sum*scale);
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <opencv2/core/core.hpp>
+
+class StemWorkspace;
+
+enum ImagePlane
+{
+    PLANE_HSV_FULL = 0, // CV_RGB2HSV_FULL of the base image
+    PLANE_H,
+    PLANE_S,
+    PLANE_V,
+    PLANE_HSV,          // CV_RGB2HSV of the base image
+    PLANE_V_EQUALIZED,  // histogram equalized V, equalization always uses the whole frame or a given LUT
+    PLANE_HSV_EQUALIZED, // H, S and equalized V interleaved
+    PLANE_RGB_EQUALIZED, // the three equalized planes come from one pass, see equalizeRgb
+    PLANE_GRAY_EQUALIZED,
+    PLANE_GRAY_BLURRED, // 3x3 box blur of the equalized gray image, the Canny input
+    PLANE_EDGES,        // Canny of the blurred equalized gray image
+
+    PLANE_COUNT
+};
+
+// Derived representations of a single image. Each plane is computed once, on first request. A context created with
+// roi() serves views into the planes its parent already has, and computes the others for its own rectangle only,
+// into the window slots of the workspace given to roi().
+class ImageContext
+{
+public:
+    // When a workspace is given, full frame planes are stored in its slots
+    explicit ImageContext(const cv::Mat &base = cv::Mat(), StemWorkspace *ws = nullptr);
+
+    // Starts over with another image, the plane buffers are kept for reuse
+    void           reset(const cv::Mat &base);
+    // Equalize V with this LUT instead of the histogram of the base image, for bands cut out of a larger frame
+    void           setEqualization(const cv::Mat &lut);
+    // The LUT V is equalized with, the given one or else the one of the histogram of the frame
+    const cv::Mat &equalization();
+    // ws is the workspace of the caller, which may differ from the parent's when several measurers share a frame
+    ImageContext   roi(const cv::Rect &r, StemWorkspace *ws = nullptr);
+    const cv::Mat &base() const { return m_base; }
+    cv::Size       size() const { return m_base.size(); }
+    bool           has(ImagePlane p) const { return m_valid[p]; }
+
+    const cv::Mat &hsvFull() { return plane(PLANE_HSV_FULL); }
+    const cv::Mat &hsvPlane(int channel) { return plane(ImagePlane(PLANE_H + channel)); }
+    const cv::Mat &hsv() { return plane(PLANE_HSV); }
+    const cv::Mat &equalizedV() { return plane(PLANE_V_EQUALIZED); }
+    const cv::Mat &equalizedHsv() { return plane(PLANE_HSV_EQUALIZED); }
+    const cv::Mat &equalizedRgb() { return plane(PLANE_RGB_EQUALIZED); }
+    const cv::Mat &equalizedGray() { return plane(PLANE_GRAY_EQUALIZED); }
+    const cv::Mat &blurredGray() { return plane(PLANE_GRAY_BLURRED); }
+    const cv::Mat &edges(int canny_param);
+    // A plane computed outside of the context, see streamFramePlanes; m must stay valid while the context is used
+    void           setPlane(ImagePlane p, const cv::Mat &m);
+
+private:
+    const cv::Mat &plane(ImagePlane p);
+    cv::Mat &      target(ImagePlane p, int type);
+    void           compute(ImagePlane p);
+
+    cv::Mat        m_base;
+    StemWorkspace *m_ws;
+    ImageContext * m_parent = nullptr;
+    cv::Rect       m_rect; // position within the parent
+    cv::Mat        m_planes[PLANE_COUNT];
+    bool           m_valid[PLANE_COUNT];
+    int            m_canny_param = -1;
+    cv::Mat        m_lut;
+    cv::Mat        m_frame_lut; // histogram LUT of a context without workspace
+};
+
+// The LUT cv::equalizeHist applies to this 8-bit image
+void equalizationLut(const cv::Mat &gray, cv::Mat &lut);
+// The same from the 256 bin histogram of total pixels
+void equalizationLut(const int *hist, int total, cv::Mat &lut);
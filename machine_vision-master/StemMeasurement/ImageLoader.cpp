@@ -0,0 +1,131 @@
+#include "ImageLoader.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <opencv2/highgui/highgui.hpp>
+
+#if defined(STEM_HAVE_JPEG_CROP)
+#include <jpeglib.h>
+#endif
+
+using namespace cv;
+
+static Mat cropWhole(const std::string &path, const Rect &roi) {
+    Mat frame = imread(path);
+    Rect r = roi & Rect(0,0,frame.cols,frame.rows);
+    return r.area()>0 ? frame(r) : Mat();
+}
+#if defined(STEM_HAVE_JPEG_CROP)
+namespace {
+struct JpegError
+{
+    jpeg_error_mgr mgr;
+    jmp_buf        jump;
+};
+void jpegErrorExit(j_common_ptr cinfo) {
+    longjmp(reinterpret_cast<JpegError *>(cinfo->err)->jump,1);
+}
+}
+// Orientation tag of the Exif APP1 segment among the saved markers, 1 ( stored upright ) when there is none
+static int exifOrientation(const jpeg_decompress_struct &cinfo) {
+    for(jpeg_saved_marker_ptr m=cinfo.marker_list; m; m=m->next) {
+        const JOCTET *d = m->data;
+        const unsigned len = m->data_length;
+        if(m->marker!=JPEG_APP0+1 || len<14 || std::memcmp(d,"Exif\0\0",6)!=0)
+            continue;
+        const JOCTET *tiff = d+6;
+        const unsigned size = len-6;
+        const bool little = tiff[0]=='I' && tiff[1]=='I';
+        if(!little && !(tiff[0]=='M' && tiff[1]=='M'))
+            continue;
+        auto u16 = [&](unsigned at) { return little ? tiff[at]|tiff[at+1]<<8 : tiff[at]<<8|tiff[at+1]; };
+        auto u32 = [&](unsigned at) { return little ? unsigned(u16(at))|unsigned(u16(at+2))<<16
+                                                    : unsigned(u16(at))<<16|unsigned(u16(at+2)); };
+        const unsigned ifd = u32(4);
+        if(ifd>size-2)
+            continue;
+        const unsigned entries = u16(ifd);
+        for(unsigned i=0; i<entries && ifd+2+12*(i+1)<=size; ++i) {
+            const unsigned entry = ifd+2+12*i;
+            if(u16(entry)==0x0112) // Orientation, a SHORT stored in the value field
+                return u16(entry+8);
+        }
+    }
+    return 1;
+}
+// false if libjpeg fails on the file or the image is stored rotated or mirrored, which cv::imread undoes from 3.1 on;
+// nothing but out is modified after setjmp
+static bool decodeJpegRoi(FILE *f, const Rect &roi, Mat &out) {
+    jpeg_decompress_struct cinfo;
+    JpegError err;
+    cinfo.err = jpeg_std_error(&err.mgr);
+    err.mgr.error_exit = jpegErrorExit;
+    jpeg_create_decompress(&cinfo);
+    if(setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    jpeg_stdio_src(&cinfo,f);
+    jpeg_save_markers(&cinfo,JPEG_APP0+1,0xFFFF);
+    jpeg_read_header(&cinfo,TRUE);
+    if(exifOrientation(cinfo)!=1) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    cinfo.out_color_space = JCS_EXT_BGR;
+    jpeg_start_decompress(&cinfo);
+    Rect r = roi & Rect(0,0,cinfo.output_width,cinfo.output_height);
+    if(r.area()==0) {
+        out = Mat();
+        jpeg_abort_decompress(&cinfo);
+        jpeg_destroy_decompress(&cinfo);
+        return true;
+    }
+    // fancy upsampling of the chroma replicates the edges of the decoded columns, an extra iMCU column to each side
+    // keeps the roi pixels equal to a full decode. libjpeg aligns the start to an iMCU column, the extra columns are
+    // cut off below.
+    const int imcu = cinfo.max_h_samp_factor*cinfo.min_DCT_scaled_size;
+    const int first = std::max(r.x-imcu,0);
+    JDIMENSION xoffset = first;
+    JDIMENSION width = std::min(r.x+r.width+imcu,int(cinfo.output_width))-first;
+    jpeg_crop_scanline(&cinfo,&xoffset,&width);
+    if(r.y>0)
+        jpeg_skip_scanlines(&cinfo,r.y);
+    out.create(r.height,width,CV_8UC3);
+    while(cinfo.output_scanline<JDIMENSION(r.y+r.height)) {
+        JSAMPROW row = out.ptr<uchar>(cinfo.output_scanline-r.y);
+        jpeg_read_scanlines(&cinfo,&row,1);
+    }
+    // the rows below roi are never decoded
+    jpeg_abort_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    out = out.colRange(r.x-xoffset,r.x-xoffset+r.width);
+    return true;
+}
+#endif
+Mat loadImageRoi(const std::string &path, const Rect &roi, bool *decoded_partially) {
+    if(decoded_partially)
+        *decoded_partially = false;
+#if defined(STEM_HAVE_JPEG_CROP)
+    FILE *f = fopen(path.c_str(),"rb");
+    if(!f)
+        return Mat();
+    unsigned char magic[3] = {0,0,0};
+    bool jpeg = fread(magic,1,3,f)==3 && magic[0]==0xFF && magic[1]==0xD8 && magic[2]==0xFF;
+    Mat out;
+    bool decoded = false;
+    if(jpeg) {
+        rewind(f);
+        decoded = decodeJpegRoi(f,roi,out);
+    }
+    fclose(f);
+    if(decoded) {
+        if(decoded_partially)
+            *decoded_partially = true;
+        return out;
+    }
+#endif
+    return cropWhole(path,roi);
+}
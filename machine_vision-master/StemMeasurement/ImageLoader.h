@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+// Pixels of roi ( clipped to the image ) of the image stored at path, BGR like cv::imread, empty if the file can not
+// be read. With libjpeg-turbo ( STEM_HAVE_JPEG_CROP ) a JPEG file is decoded only for the scanlines and iMCU columns
+// covering roi; other formats, JPEG files with an Exif orientation other than 1 ( cv::imread rotates those ) and JPEG
+// files the partial decoder rejects are read whole with cv::imread and cropped. decoded_partially, when given, tells
+// which of the two happened.
+cv::Mat loadImageRoi(const std::string &path, const cv::Rect &roi, bool *decoded_partially = nullptr);
@@ -0,0 +1,204 @@
+#include "MeasurementPipeline.h"
+#include "BoundedQueue.h"
+#include "ImageLoader.h"
+#include "RoiCache.h"
+#include "ThreadSchedule.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+namespace {
+typedef chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point t) {
+    return chrono::duration<double>(Clock::now()-t).count();
+}
+struct DecodedImage
+{
+    size_t  index = 0;
+    cv::Mat pic;
+    double  decode_ms = 0;
+};
+struct MeasuredImage
+{
+    size_t             index = 0;
+    vector<StemResult> results; // one, or one per plant with PipelineOptions::all_plants
+};
+// counters of a single thread, merged into PipelineStats when the thread is done
+struct ThreadStats
+{
+    StageStats stage;
+    QueueStats out;
+};
+void backoff(int &spins) {
+    // spin a little, then give the core away, so that a waiting stage does not slow down the busy ones
+    if(spins<64) {
+        if(++spins>16)
+            this_thread::yield();
+    }
+    else
+        this_thread::sleep_for(chrono::microseconds(200));
+}
+template<class T>
+void push(BoundedQueue<T> &q, T &item, ThreadStats &st) {
+    if(!q.tryPush(std::move(item))) {
+        st.out.full_waits++;
+        Clock::time_point start = Clock::now();
+        for(int spins=0; !q.tryPush(std::move(item));)
+            backoff(spins);
+        st.stage.wait_s += secondsSince(start);
+    }
+    size_t depth = q.size();
+    st.out.pushes++;
+    st.out.depth_sum += depth;
+    st.out.depth_max = std::max(st.out.depth_max,depth);
+}
+// false once all producers have finished and the queue is drained
+template<class T>
+bool pop(BoundedQueue<T> &q, const atomic<int> &producers, T &item, ThreadStats &st) {
+    if(q.tryPop(item))
+        return true;
+    Clock::time_point start = Clock::now();
+    bool got = false;
+    for(int spins=0; ; backoff(spins)) {
+        if(q.tryPop(item)) {
+            got = true;
+            break;
+        }
+        if(producers.load()==0) {
+            got = q.tryPop(item); // pushed between the two checks
+            break;
+        }
+    }
+    st.stage.wait_s += secondsSince(start);
+    return got;
+}
+void merge(StageStats &to, const StageStats &from) {
+    to.items += from.items;
+    to.busy_s += from.busy_s;
+    to.wait_s += from.wait_s;
+}
+void merge(QueueStats &to, const QueueStats &from) {
+    to.pushes += from.pushes;
+    to.depth_sum += from.depth_sum;
+    to.depth_max = std::max(to.depth_max,from.depth_max);
+    to.full_waits += from.full_waits;
+}
+}
+MeasurementPipeline::MeasurementPipeline(const PipelineOptions &opts) : m_opts(opts) {
+}
+PipelineStats MeasurementPipeline::run(const vector<string> &images, const ResultSink &sink) {
+    PipelineStats stats;
+    stats.decode.threads = std::max(1,m_opts.decoders);
+    stats.measure.threads = std::max(1,m_opts.workers);
+    stats.write.threads = 1;
+    BoundedQueue<DecodedImage> decoded(std::max<size_t>(1,m_opts.queue_depth));
+    BoundedQueue<MeasuredImage> measured(std::max<size_t>(1,m_opts.queue_depth));
+    stats.decoded.capacity = decoded.capacity();
+    stats.measured.capacity = measured.capacity();
+
+    atomic<size_t> next_image(0);
+    atomic<int> decoding(stats.decode.threads);
+    atomic<int> measuring(stats.measure.threads);
+    mutex stats_lock;
+    auto decoder = [&]() {
+        ThreadStats st;
+        for(size_t idx=next_image++; idx<images.size(); idx=next_image++) {
+            Clock::time_point start = Clock::now();
+            DecodedImage item;
+            item.index = idx;
+            try {
+                item.pic = loadImageRoi(images[idx],m_opts.params.crop_area);
+            }
+            catch(const cv::Exception &e) {
+                fprintf(stderr,"%s: %s\n",images[idx].c_str(),e.what());
+            }
+            item.decode_ms = 1000*secondsSince(start);
+            st.stage.busy_s += item.decode_ms/1000;
+            st.stage.items++;
+            push(decoded,item,st);
+        }
+        lock_guard<mutex> guard(stats_lock);
+        merge(stats.decode,st.stage);
+        merge(stats.decoded,st.out);
+        decoding--;
+    };
+    auto worker = [&](int index) {
+        if(m_opts.pin_workers && !pinCurrentThread(index))
+            fprintf(stderr,"Could not pin worker %d\n",index);
+        StemMeasurer measurer(m_opts.params);
+        measurer.setCalibration(m_opts.calibration);
+        ThreadStats st;
+        DecodedImage item;
+        while(pop(decoded,decoding,item,st)) {
+            Clock::time_point start = Clock::now();
+            MeasuredImage out;
+            out.index = item.index;
+            if(m_opts.all_plants)
+                out.results = measurer.measurePlants(item.pic,images[item.index]);
+            else if(m_opts.roi_cache)
+                out.results.assign(1,measureCached(measurer,item.pic,images[item.index],*m_opts.roi_cache));
+            else
+                out.results.assign(1,measurer.measureDecoded(item.pic,images[item.index]));
+            for(StemResult &res : out.results)
+                res.elapsed_ms += item.decode_ms;
+            item.pic = cv::Mat();
+            st.stage.busy_s += secondsSince(start);
+            st.stage.items++;
+            push(measured,out,st);
+        }
+        lock_guard<mutex> guard(stats_lock);
+        merge(stats.measure,st.stage);
+        merge(stats.measured,st.out);
+        mergeStageTimes(stats.steps,measurer.stageTimes());
+        measuring--;
+    };
+    auto writer = [&]() {
+        ThreadStats st;
+        MeasuredImage item;
+        while(pop(measured,measuring,item,st)) {
+            Clock::time_point start = Clock::now();
+            for(const StemResult &res : item.results)
+                sink(item.index,images[item.index],res);
+            st.stage.busy_s += secondsSince(start);
+            st.stage.items++;
+        }
+        lock_guard<mutex> guard(stats_lock);
+        merge(stats.write,st.stage);
+    };
+
+    Clock::time_point start = Clock::now();
+    vector<thread> pool;
+    for(int i=0; i<stats.decode.threads; ++i)
+        pool.emplace_back(decoder);
+    for(int i=0; i<stats.measure.threads; ++i)
+        pool.emplace_back(worker,i);
+    pool.emplace_back(writer);
+    for(thread &t : pool)
+        t.join();
+    stats.wall_s = secondsSince(start);
+    return stats;
+}
+void printPipelineStats(FILE *out, const PipelineStats &stats) {
+    const char *names[] = {"decode","measure","write"};
+    const StageStats *stages[] = {&stats.decode,&stats.measure,&stats.write};
+    for(int i=0; i<3; ++i) {
+        const StageStats &st(*stages[i]);
+        double waiting = stats.wall_s>0 ? st.wait_s/(st.threads*stats.wall_s) : 0;
+        fprintf(out,"stage %-7s %2d threads, %zu images, %5.1f%% busy, %5.1f%% waiting on queues\n",names[i],
+                st.threads,st.items,100*st.utilisation(stats.wall_s),100*waiting);
+    }
+    const char *queue_names[] = {"decoded","measured"};
+    const QueueStats *queues[] = {&stats.decoded,&stats.measured};
+    for(int i=0; i<2; ++i) {
+        const QueueStats &q(*queues[i]);
+        fprintf(out,"queue %-8s capacity %zu, depth %.2f avg %zu max, full on %zu of %zu pushes\n",queue_names[i],
+                q.capacity,q.meanDepth(),q.depth_max,q.full_waits,q.pushes);
+    }
+    printStageTimes(out,stats.steps,stats.measure.items);
+}
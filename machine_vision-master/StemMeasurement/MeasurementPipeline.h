@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "StemMeasurer.h"
+
+class RoiCache;
+
+struct PipelineOptions
+{
+    int             decoders    = 1; // threads running loadImageRoi
+    int             workers     = 1; // threads measuring, each with its own StemMeasurer
+    size_t          queue_depth = 8; // capacity of each queue between the stages, rounded up to a power of two
+    bool            pin_workers = false; // worker i runs on the i-th allowed CPU only
+    RoiCache       *roi_cache   = nullptr; // seeds the search from the previous lap, see measureCached
+    bool            all_plants  = false;   // measurePlants instead of the first plant only, roi_cache is not used
+    StemParams      params;
+    StemCalibration calibration; // scale of every image, see StemMeasurer::setCalibration
+};
+
+struct StageStats
+{
+    int    threads = 0;
+    size_t items   = 0;
+    double busy_s  = 0; // summed over the threads of the stage
+    double wait_s  = 0; // time spent on an empty input or a full output queue
+
+    double utilisation(double wall_s) const { return threads > 0 && wall_s > 0 ? busy_s / (threads * wall_s) : 0; }
+};
+
+struct QueueStats
+{
+    size_t capacity   = 0;
+    size_t pushes     = 0;
+    double depth_sum  = 0; // depth right after every push
+    size_t depth_max  = 0;
+    size_t full_waits = 0; // pushes that found the queue full
+
+    double meanDepth() const { return pushes > 0 ? depth_sum / pushes : 0; }
+};
+
+struct PipelineStats
+{
+    double     wall_s = 0;
+    StageStats decode;
+    StageStats measure;
+    StageStats write;
+    QueueStats decoded;  // decode -> measure
+    QueueStats measured; // measure -> write
+    StageTimes steps;    // stage graph steps of all workers, see StemMeasurer::stageTimes
+};
+
+// Batch measurement in three overlapping stages: decoder threads load the crop areas, workers measure them and a
+// single writer thread hands the results to the sink in completion order, one call per measured plant. The stages
+// are connected by bounded lock-free queues, a stage that gets ahead waits for room in its output queue.
+class MeasurementPipeline
+{
+public:
+    typedef std::function<void(size_t index, const std::string &path, const StemResult &res)> ResultSink;
+
+    explicit MeasurementPipeline(const PipelineOptions &opts);
+
+    PipelineStats run(const std::vector<std::string> &images, const ResultSink &sink);
+
+private:
+    PipelineOptions m_opts;
+};
+
+// Human readable stage utilisation and queue depths, one line per stage and queue, then the measuring steps
+void printPipelineStats(FILE *out, const PipelineStats &stats);
@@ -0,0 +1,174 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace std;
+
+namespace {
+thread_local void *t_block = nullptr;
+
+const char *stage_names[STAGE_COUNT] = {"frame","wire_edges","wire_row","plant_top","trim","stem_width",
+                                        "verify_stems"};
+const char *counter_names[COUNTER_COUNT] = {"wire_candidates","candidate_rows","stem_candidates","verify_calls",
+                                            "stems_verified"};
+
+uint64_t percentile(const vector<uint64_t> &buckets,uint64_t count,uint64_t max,double p) {
+    uint64_t rank = std::max<uint64_t>(1,uint64_t(p*count+0.5));
+    uint64_t seen = 0;
+    for(size_t b=0; b<buckets.size(); ++b) {
+        seen += buckets[b];
+        if(seen>=rank)
+            return std::min(LatencyHistogram::bucketTop(b),max);
+    }
+    return max;
+}
+}
+
+const char *metricStageName(MetricStage stage) {
+    return stage_names[stage];
+}
+const char *metricCounterName(MetricCounter counter) {
+    return counter_names[counter];
+}
+
+LatencyHistogram::LatencyHistogram() {
+    for(int b=0; b<BUCKETS; ++b)
+        m_buckets[b].store(0,memory_order_relaxed);
+    m_count.store(0,memory_order_relaxed);
+    m_sum.store(0,memory_order_relaxed);
+    m_max.store(0,memory_order_relaxed);
+}
+int LatencyHistogram::bucketOf(uint64_t ns) {
+    // values below 64 have a bucket each, above that 32 buckets share each power of two
+    ns = std::min<uint64_t>(ns,(uint64_t(1)<<48)-1);
+    if(ns<(2u<<SUB_BITS))
+        return int(ns);
+    int msb = 63-__builtin_clzll(ns);
+    int shift = msb-SUB_BITS;
+    return (shift<<SUB_BITS)+int(ns>>shift);
+}
+uint64_t LatencyHistogram::bucketTop(int bucket) {
+    if(bucket<(2<<SUB_BITS))
+        return bucket;
+    int shift = (bucket>>SUB_BITS)-1;
+    uint64_t mantissa = bucket-(shift<<SUB_BITS);
+    return ((mantissa+1)<<shift)-1;
+}
+void LatencyHistogram::record(uint64_t ns) {
+    bump(m_buckets[bucketOf(ns)],1);
+    bump(m_count,1);
+    bump(m_sum,ns);
+    if(ns>m_max.load(memory_order_relaxed))
+        m_max.store(ns,memory_order_relaxed);
+}
+void LatencyHistogram::addTo(vector<uint64_t> &buckets,uint64_t &count,uint64_t &sum,uint64_t &max) const {
+    buckets.resize(BUCKETS,0);
+    for(int b=0; b<BUCKETS; ++b)
+        buckets[b] += m_buckets[b].load(memory_order_relaxed);
+    count += m_count.load(memory_order_relaxed);
+    sum += m_sum.load(memory_order_relaxed);
+    max = std::max<uint64_t>(max,m_max.load(memory_order_relaxed));
+}
+
+Metrics &Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+Metrics::~Metrics() {
+    stop();
+}
+void Metrics::start() {
+    stop();
+    lock_guard<mutex> guard(m_lock);
+    m_started = chrono::steady_clock::now();
+    m_stopping = false;
+    m_enabled = true;
+}
+void Metrics::stop() {
+    m_enabled = false;
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    if(m_dumper.joinable())
+        m_dumper.join();
+}
+Metrics::ThreadBlock &Metrics::local() {
+    if(!t_block) {
+        unique_ptr<ThreadBlock> block(new ThreadBlock);
+        for(atomic<uint64_t> &c : block->counters)
+            c.store(0,memory_order_relaxed);
+        lock_guard<mutex> guard(m_lock);
+        t_block = block.get();
+        m_blocks.push_back(std::move(block));
+    }
+    return *static_cast<ThreadBlock *>(t_block);
+}
+void Metrics::count(MetricCounter counter,uint64_t n) {
+    atomic<uint64_t> &c(local().counters[counter]);
+    c.store(c.load(memory_order_relaxed)+n,memory_order_relaxed);
+}
+void Metrics::writeJson(FILE *out,const StageTimes *steps) const {
+    lock_guard<mutex> guard(m_lock);
+    double wall_s = chrono::duration<double>(chrono::steady_clock::now()-m_started).count();
+    fprintf(out,"{\n  \"wall_s\": %.3f,\n  \"threads\": %zu,\n  \"stages\": {",wall_s,m_blocks.size());
+    vector<uint64_t> buckets;
+    for(int s=0; s<STAGE_COUNT; ++s) {
+        buckets.assign(LatencyHistogram::BUCKETS,0);
+        uint64_t count = 0, sum = 0, max = 0;
+        for(const unique_ptr<ThreadBlock> &block : m_blocks)
+            block->stages[s].addTo(buckets,count,sum,max);
+        fprintf(out,"%s\n    \"%s\": {\"count\": %llu, \"mean_us\": %.1f, \"p50_us\": %.1f, \"p90_us\": %.1f, "
+                    "\"p99_us\": %.1f, \"max_us\": %.1f}",s>0 ? "," : "",stage_names[s],(unsigned long long)count,
+                count>0 ? sum/1000.0/count : 0.0,percentile(buckets,count,max,0.5)/1000.0,
+                percentile(buckets,count,max,0.9)/1000.0,percentile(buckets,count,max,0.99)/1000.0,max/1000.0);
+    }
+    fprintf(out,"\n  },\n  \"counters\": {");
+    for(int c=0; c<COUNTER_COUNT; ++c) {
+        uint64_t total = 0;
+        for(const unique_ptr<ThreadBlock> &block : m_blocks)
+            total += block->counters[c].load(memory_order_relaxed);
+        fprintf(out,"%s\n    \"%s\": %llu",c>0 ? "," : "",counter_names[c],(unsigned long long)total);
+    }
+    fprintf(out,"\n  }");
+    if(steps) {
+        fprintf(out,",\n  \"steps\": {");
+        bool first = true;
+        for(const auto &entry : *steps) {
+            const StageTime &t(entry.second);
+            fprintf(out,"%s\n    \"%s\": {\"runs\": %zu, \"mean_us\": %.1f}",first ? "" : ",",entry.first.c_str(),
+                    t.runs,t.runs>0 ? 1000*t.total_ms/t.runs : 0.0);
+            first = false;
+        }
+        fprintf(out,"\n  }");
+    }
+    fprintf(out,"\n}\n");
+}
+bool Metrics::writeJson(const string &path,const StageTimes *steps) const {
+    // readers of a periodically rewritten report never see it half written
+    string tmp = path+".tmp";
+    FILE *out = fopen(tmp.c_str(),"w");
+    if(!out)
+        return false;
+    writeJson(out,steps);
+    bool ok = fclose(out)==0;
+    return ok && rename(tmp.c_str(),path.c_str())==0;
+}
+void Metrics::startDump(const string &path,double interval_s) {
+    if(m_dumper.joinable() || interval_s<=0)
+        return;
+    m_dumper = thread(&Metrics::dumpLoop,this,path,interval_s);
+}
+void Metrics::dumpLoop(string path,double interval_s) {
+    unique_lock<mutex> guard(m_lock);
+    for(;;) {
+        if(m_wake.wait_for(guard,chrono::duration<double>(interval_s),[this] { return m_stopping; }))
+            return;
+        guard.unlock();
+        if(!writeJson(path))
+            perror(path.c_str());
+        guard.lock();
+    }
+}
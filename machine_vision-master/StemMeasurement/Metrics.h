@@ -0,0 +1,138 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StageGraph.h"
+
+// Timed stages, a stage contains the ones it calls: frame contains all others, stem_width contains verify_stems
+enum MetricStage
+{
+    STAGE_FRAME = 0,  // one measure call
+    STAGE_WIRE_EDGES, // masked Canny edges of the wire search area
+    STAGE_WIRE_ROW,   // first row with wire candidates, or the wire traces of measurePlants
+    STAGE_PLANT_TOP,
+    STAGE_TRIM,       // trimToGreen
+    STAGE_STEM_WIDTH, // stem edges and their verification
+    STAGE_VERIFY,     // stem candidates of the edges, verifyStems on each
+
+    STAGE_COUNT
+};
+enum MetricCounter
+{
+    COUNT_WIRE_CANDIDATES = 0, // edge runs of the wire row
+    COUNT_CANDIDATE_ROWS,      // rows whose stem candidates were verified
+    COUNT_STEM_CANDIDATES,     // edge pairs found in those rows
+    COUNT_VERIFY_CALLS,
+    COUNT_STEMS_VERIFIED,
+
+    COUNTER_COUNT
+};
+const char *metricStageName(MetricStage stage);
+const char *metricCounterName(MetricCounter counter);
+
+// Latency histogram with a few percent relative error: 32 linear buckets per power of two above 64 ns.
+// Written by a single thread without locks, read by any thread; a reader may see a record half done.
+class LatencyHistogram
+{
+public:
+    static const int SUB_BITS = 5;
+    static const int BUCKETS  = (49 - SUB_BITS) << SUB_BITS; // up to 2^48 ns
+
+    LatencyHistogram();
+    void     record(uint64_t ns);
+    void     addTo(std::vector<uint64_t> &buckets, uint64_t &count, uint64_t &sum, uint64_t &max) const;
+    static int      bucketOf(uint64_t ns);
+    static uint64_t bucketTop(int bucket); // largest value of the bucket
+
+private:
+    static void bump(std::atomic<uint64_t> &v, uint64_t by) {
+        v.store(v.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+    std::atomic<uint64_t> m_buckets[BUCKETS];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_max;
+};
+
+// Stage latencies and counters of the measuring threads. Each thread records into its own block, the report merges
+// the blocks of all threads that ever recorded. Disabled by default, a disabled timer or counter costs a single
+// relaxed atomic load; building with STEM_NO_METRICS removes them.
+class Metrics
+{
+public:
+    static Metrics &instance();
+    ~Metrics();
+
+    void start();
+    void stop(); // also stops the periodic dump, blocks keep their values
+    bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void record(MetricStage stage, uint64_t ns) { local().stages[stage].record(ns); }
+    void count(MetricCounter counter, uint64_t n);
+
+    // steps are the stage graph times of the run, added to the report when given
+    void writeJson(FILE *out, const StageTimes *steps = nullptr) const;
+    bool writeJson(const std::string &path, const StageTimes *steps = nullptr) const; // replaces path atomically
+    // Rewrites the report at path every interval_s until stop(), for runs that do not end
+    void startDump(const std::string &path, double interval_s);
+
+private:
+    struct ThreadBlock
+    {
+        LatencyHistogram      stages[STAGE_COUNT];
+        std::atomic<uint64_t> counters[COUNTER_COUNT];
+    };
+    Metrics() : m_enabled(false) {}
+    ThreadBlock &local();
+    void         dumpLoop(std::string path, double interval_s);
+
+    std::atomic<bool>                         m_enabled;
+    std::chrono::steady_clock::time_point     m_started;
+    mutable std::mutex                        m_lock; // m_blocks and the dump thread
+    std::vector<std::unique_ptr<ThreadBlock>> m_blocks;
+    std::thread                               m_dumper;
+    std::condition_variable                   m_wake;
+    bool                                      m_stopping = false;
+};
+
+// Records the time until the end of the scope into stage when metrics are enabled at its start
+class ScopedStageTimer
+{
+public:
+    explicit ScopedStageTimer(MetricStage stage) : m_stage(stage), m_on(Metrics::instance().enabled()) {
+        if (m_on)
+            m_start = std::chrono::steady_clock::now();
+    }
+    ~ScopedStageTimer() {
+        if (m_on)
+            Metrics::instance().record(m_stage, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                    std::chrono::steady_clock::now() - m_start).count());
+    }
+
+private:
+    MetricStage                           m_stage;
+    bool                                  m_on;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#ifdef STEM_NO_METRICS
+#define METRIC_TIMER(stage) do { } while (0)
+#define METRIC_COUNT(counter, n) do { } while (0)
+#else
+#define METRIC_CONCAT_(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT_(a, b)
+#define METRIC_TIMER(stage) ScopedStageTimer METRIC_CONCAT(metric_timer_, __LINE__)(stage)
+#define METRIC_COUNT(counter, n)                                                                                       \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (Metrics::instance().enabled())                                                                             \
+            Metrics::instance().count(counter, n);                                                                     \
+    } while (0)
+#endif
@@ -0,0 +1,201 @@
+#include "RangeMask.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+using namespace cv;
+
+RangeMask &RangeMask::within(int channel, int lo, int hi) {
+    CV_Assert(channel>=0 && channel<4);
+    ChannelRange r;
+    r.channel = channel;
+    if(lo>hi || hi<0 || lo>255) {
+        r.lo = 1;
+        r.hi = 0;
+    }
+    else {
+        r.lo = std::max(lo,0);
+        r.hi = std::min(hi,255);
+    }
+    m_rules.push_back(r);
+    return *this;
+}
+RangeMask &RangeMask::below(int channel, int value) {
+    return within(channel,0,value-1);
+}
+RangeMask &RangeMask::above(int channel, int value) {
+    return within(channel,value+1,255);
+}
+const char *RangeMask::implementation() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSSE3__)
+    return "ssse3";
+#else
+    return "scalar";
+#endif
+}
+namespace {
+// Rules folded into one lookup table per channel, used for the scalar path and the row tails
+struct ChannelLuts
+{
+    uchar lut[4][256];
+    ChannelLuts(const std::vector<ChannelRange> &rules, RangeCombine combine, int cn) {
+        // channels without rules hold the neutral element of the combination
+        std::memset(lut,combine==RANGES_ALL ? 255 : 0,sizeof(lut));
+        for(const ChannelRange &r : rules) {
+            if(r.channel>=cn)
+                continue;
+            for(int v=0; v<256; ++v) {
+                bool in = v>=r.lo && v<=r.hi;
+                if(combine==RANGES_ALL)
+                    lut[r.channel][v] &= in ? 255 : 0;
+                else
+                    lut[r.channel][v] |= in ? 255 : 0;
+            }
+        }
+    }
+};
+template<int CN, bool ALL>
+void scalarRow(const uchar *src, uchar *dst, int from, int to, const ChannelLuts &l) {
+    for(int x=from; x<to; ++x) {
+        const uchar *px = src+x*CN;
+        uchar m = l.lut[0][px[0]];
+        for(int c=1; c<CN; ++c)
+            m = ALL ? (m & l.lut[c][px[c]]) : (m | l.lut[c][px[c]]);
+        dst[x] = m;
+    }
+}
+typedef void (*RowFunc)(const uchar *, uchar *, int, int, const ChannelLuts &);
+RowFunc scalarRowFunc(int cn, bool all) {
+    switch(cn) {
+        case 1: return all ? scalarRow<1,true> : scalarRow<1,false>;
+        case 2: return all ? scalarRow<2,true> : scalarRow<2,false>;
+        case 3: return all ? scalarRow<3,true> : scalarRow<3,false>;
+        default: return all ? scalarRow<4,true> : scalarRow<4,false>;
+    }
+}
+
+#if defined(__AVX2__)
+typedef __m256i Vec;
+const int LANES = 32;
+inline Vec splat(uchar v) { return _mm256_set1_epi8(char(v)); }
+inline Vec inRange(Vec v, Vec lo, Vec hi) {
+    Vec ge = _mm256_cmpeq_epi8(_mm256_max_epu8(v,lo),v);
+    Vec le = _mm256_cmpeq_epi8(_mm256_min_epu8(v,hi),v);
+    return _mm256_and_si256(ge,le);
+}
+inline Vec vand(Vec a, Vec b) { return _mm256_and_si256(a,b); }
+inline Vec vor(Vec a, Vec b) { return _mm256_or_si256(a,b); }
+inline Vec load1(const uchar *p) { return _mm256_loadu_si256((const __m256i *)p); }
+inline void store(uchar *p, Vec v) { _mm256_storeu_si256((__m256i *)p,v); }
+inline Vec loadSplit(const uchar *p) {
+    // low lane gets p[0..15], high lane p[48..63], so both lanes hold the same pixel phase
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+                                   _mm_loadu_si128((const __m128i *)(p+48)),1);
+}
+inline Vec shuffle(Vec v, const signed char *m) {
+    return _mm256_shuffle_epi8(v,_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)m)));
+}
+#elif defined(__SSSE3__)
+typedef __m128i Vec;
+const int LANES = 16;
+inline Vec splat(uchar v) { return _mm_set1_epi8(char(v)); }
+inline Vec inRange(Vec v, Vec lo, Vec hi) {
+    Vec ge = _mm_cmpeq_epi8(_mm_max_epu8(v,lo),v);
+    Vec le = _mm_cmpeq_epi8(_mm_min_epu8(v,hi),v);
+    return _mm_and_si128(ge,le);
+}
+inline Vec vand(Vec a, Vec b) { return _mm_and_si128(a,b); }
+inline Vec vor(Vec a, Vec b) { return _mm_or_si128(a,b); }
+inline Vec load1(const uchar *p) { return _mm_loadu_si128((const __m128i *)p); }
+inline void store(uchar *p, Vec v) { _mm_storeu_si128((__m128i *)p,v); }
+inline Vec loadSplit(const uchar *p) { return _mm_loadu_si128((const __m128i *)p); }
+inline Vec shuffle(Vec v, const signed char *m) {
+    return _mm_shuffle_epi8(v,_mm_loadu_si128((const __m128i *)m));
+}
+#endif
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#define RANGE_MASK_SIMD 1
+// Byte gathers turning three 16 byte blocks of interleaved pixels into 16 values of one channel
+const signed char deinterleave[3][3][16] = {
+    { {0,3,6,9,12,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+      {-1,-1,-1,-1,-1,-1,2,5,8,11,14,-1,-1,-1,-1,-1},
+      {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,1,4,7,10,13} },
+    { {1,4,7,10,13,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+      {-1,-1,-1,-1,-1,0,3,6,9,12,15,-1,-1,-1,-1,-1},
+      {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,2,5,8,11,14} },
+    { {2,5,8,11,14,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+      {-1,-1,-1,-1,-1,1,4,7,10,13,-1,-1,-1,-1,-1,-1},
+      {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,0,3,6,9,12,15} },
+};
+const int MAX_SIMD_RULES = 8;
+template<int CN, bool ALL>
+int simdRow(const uchar *src, uchar *dst, int width, const ChannelRange *rules, int rule_count) {
+    Vec lo[MAX_SIMD_RULES], hi[MAX_SIMD_RULES];
+    for(int r=0; r<rule_count; ++r) {
+        lo[r] = splat(rules[r].lo);
+        hi[r] = splat(rules[r].hi);
+    }
+    int x=0;
+    for(; x+LANES<=width; x+=LANES) {
+        Vec ch[3];
+        if(CN==1)
+            ch[0] = load1(src+x);
+        else {
+            // LANES/16 groups of 16 pixels, each group is 48 consecutive bytes
+            const uchar *p = src+x*3;
+            Vec a = loadSplit(p), b = loadSplit(p+16), c = loadSplit(p+32);
+            for(int k=0; k<3; ++k)
+                ch[k] = vor(vor(shuffle(a,deinterleave[k][0]),shuffle(b,deinterleave[k][1])),
+                            shuffle(c,deinterleave[k][2]));
+        }
+        Vec m = splat(ALL ? 255 : 0);
+        for(int r=0; r<rule_count; ++r) {
+            Vec in = inRange(ch[rules[r].channel],lo[r],hi[r]);
+            m = ALL ? vand(m,in) : vor(m,in);
+        }
+        store(dst+x,m);
+    }
+    return x;
+}
+#endif
+}
+void RangeMask::apply(const Mat &src, Mat &mask) const {
+    CV_Assert(src.depth()==CV_8U && src.channels()<=4);
+    const int cn = src.channels();
+    const bool all = m_combine==RANGES_ALL;
+    mask.create(src.size(),CV_8UC1);
+    ChannelLuts luts(m_rules,m_combine,cn);
+    RowFunc tail = scalarRowFunc(cn,all);
+#ifdef RANGE_MASK_SIMD
+    std::vector<ChannelRange> used;
+    for(const ChannelRange &r : m_rules)
+        if(r.channel<cn)
+            used.push_back(r);
+    const int count = int(used.size());
+    const ChannelRange *rules = used.empty() ? nullptr : &used[0];
+    const bool simd = (cn==1 || cn==3) && count<=MAX_SIMD_RULES;
+#endif
+    for(int y=0; y<src.rows; ++y) {
+        const uchar *s = src.ptr<uchar>(y);
+        uchar *d = mask.ptr<uchar>(y);
+        int x=0;
+#ifdef RANGE_MASK_SIMD
+        if(simd) {
+            if(cn==1)
+                x = all ? simdRow<1,true>(s,d,src.cols,rules,count) : simdRow<1,false>(s,d,src.cols,rules,count);
+            else
+                x = all ? simdRow<3,true>(s,d,src.cols,rules,count) : simdRow<3,false>(s,d,src.cols,rules,count);
+        }
+#endif
+        tail(s,d,x,src.cols,luts);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+enum RangeCombine
+{
+    RANGES_ANY = 0, // pixel is set when any rule matches
+    RANGES_ALL,     // pixel is set when every rule matches
+};
+
+struct ChannelRange
+{
+    int   channel;
+    uchar lo; // inclusive, lo>hi never matches
+    uchar hi;
+};
+
+// Per-channel threshold mask computed in a single pass over interleaved 8-bit pixels, replacing chains of
+// compare/bitwise_or over split planes. The result is 255 where the rules match and 0 elsewhere, like cv::compare.
+class RangeMask
+{
+public:
+    explicit RangeMask(RangeCombine combine = RANGES_ANY) : m_combine(combine) {}
+
+    RangeMask &below(int channel, int value); // channel < value
+    RangeMask &above(int channel, int value); // channel > value
+    RangeMask &within(int channel, int lo, int hi);
+
+    // src is CV_8UC1..CV_8UC4, may be a ROI view
+    void apply(const cv::Mat &src, cv::Mat &mask) const;
+
+    const std::vector<ChannelRange> &rules() const { return m_rules; }
+    static const char *implementation(); // instruction set used for 1 and 3 channel images
+
+private:
+    std::vector<ChannelRange> m_rules;
+    RangeCombine              m_combine;
+};
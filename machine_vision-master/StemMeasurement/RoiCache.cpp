@@ -0,0 +1,235 @@
+#include "RoiCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+struct RoiCache::Header
+{
+    char     magic[8];
+    uint32_t layout;
+    uint32_t capacity;
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t stale;
+    uint64_t seeded;
+    uint64_t searched;
+    double   searched_ms;
+    double   saved_ms;
+};
+struct RoiCache::Entry
+{
+    uint64_t hash;    // 0 - empty slot
+    char     key[56]; // PlantKey::str(), cut to fit
+    int64_t  updated; // seconds since the epoch
+    int32_t  hang_line_row;
+    int32_t  hang_line_x;
+    int32_t  plant_top;
+    int32_t  stem_area[4];
+    float    stem_width_px;
+    uint8_t  equalization[256];
+};
+static const char cache_magic[8] = {'S','T','E','M','R','O','I','C'};
+static const int  probe_length   = 16;
+
+bool parsePlantKey(const string &path, PlantKey &key) {
+    size_t slash = path.find_last_of("/\\");
+    string name = path.substr(slash==string::npos ? 0 : slash+1);
+    name = name.substr(0,name.rfind('.'));
+    vector<string> fields;
+    size_t from = 0;
+    for(size_t sep=name.find('_'); ; sep=name.find('_',from)) {
+        fields.push_back(name.substr(from,sep==string::npos ? string::npos : sep-from));
+        if(sep==string::npos)
+            break;
+        from = sep+1;
+    }
+    // panoramic images have no sequence id
+    if(fields.size()<5 || fields[0]=="panoramic" || (fields[3]!="left" && fields[3]!="right"))
+        return false;
+    for(int i=0; i<4; ++i) {
+        if(fields[i].empty())
+            return false;
+    }
+    key.greenhouse = fields[0];
+    key.lane = fields[1];
+    key.sequence = fields[2];
+    key.side = fields[3];
+    return true;
+}
+static uint64_t keyHash(const string &key) {
+    // FNV-1a, 0 marks empty slots
+    uint64_t h = 14695981039346656037ull;
+    for(unsigned char c : key) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h ? h : 1;
+}
+RoiCache::RoiCache() : m_header(nullptr), m_entries(nullptr), m_capacity(0), m_max_age_s(0) {
+}
+RoiCache::~RoiCache() {
+    close();
+}
+bool RoiCache::open(const string &path, size_t capacity, int max_age_hours) {
+    close();
+    size_t cap = 2;
+    while(cap<capacity)
+        cap *= 2;
+    const qint64 size = sizeof(Header)+cap*sizeof(Entry);
+    m_file.setFileName(QString::fromLocal8Bit(path.c_str()));
+    if(!m_file.open(QIODevice::ReadWrite))
+        return false;
+    bool fresh = m_file.size()!=size;
+    if(fresh && !m_file.resize(size)) {
+        m_file.close();
+        return false;
+    }
+    uchar *data = m_file.map(0,size);
+    if(!data) {
+        m_file.close();
+        return false;
+    }
+    m_header = reinterpret_cast<Header *>(data);
+    m_entries = reinterpret_cast<Entry *>(data+sizeof(Header));
+    const uint32_t cache_layout = (1u<<16) | sizeof(Entry); // format version and entry size
+    if(fresh || memcmp(m_header->magic,cache_magic,sizeof(cache_magic))!=0 || m_header->layout!=cache_layout ||
+       m_header->capacity!=cap) {
+        memset(data,0,size);
+        memcpy(m_header->magic,cache_magic,sizeof(cache_magic));
+        m_header->layout = cache_layout;
+        m_header->capacity = cap;
+    }
+    m_capacity = cap;
+    m_max_age_s = int64_t(max_age_hours)*3600;
+    m_stats = RoiCacheStats();
+    return true;
+}
+void RoiCache::close() {
+    if(m_header)
+        m_file.unmap(reinterpret_cast<uchar *>(m_header));
+    if(m_file.isOpen())
+        m_file.close();
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_capacity = 0;
+}
+RoiCache::Entry *RoiCache::find(uint64_t hash, const string &key, bool for_insert) {
+    Entry *oldest = nullptr;
+    for(int i=0; i<probe_length; ++i) {
+        Entry &e(m_entries[(hash+i)&(m_capacity-1)]);
+        if(e.hash==0)
+            return for_insert ? &e : nullptr;
+        if(e.hash==hash && 0==strncmp(e.key,key.c_str(),sizeof(e.key)-1))
+            return &e;
+        if(!oldest || e.updated<oldest->updated)
+            oldest = &e;
+    }
+    return for_insert ? oldest : nullptr;
+}
+bool RoiCache::lookup(const PlantKey &key, StemTrack &track) {
+    const string k = key.str();
+    lock_guard<mutex> guard(m_lock);
+    if(!isOpen())
+        return false;
+    m_stats.lookups++;
+    m_header->lookups++;
+    const Entry *e = find(keyHash(k),k,false);
+    if(!e)
+        return false;
+    if(int64_t(time(nullptr))-e->updated>m_max_age_s) {
+        m_stats.stale++;
+        m_header->stale++;
+        return false;
+    }
+    m_stats.hits++;
+    m_header->hits++;
+    track.valid = true;
+    track.hang_line_row = e->hang_line_row;
+    track.hang_line_x = e->hang_line_x;
+    track.plant_top = e->plant_top;
+    track.stem_area = Rect(e->stem_area[0],e->stem_area[1],e->stem_area[2],e->stem_area[3]);
+    Mat(1,256,CV_8UC1,const_cast<uint8_t *>(e->equalization)).copyTo(track.equalization);
+    track.tracked_frames = 0;
+    return true;
+}
+void RoiCache::update(const PlantKey &key, bool seeded, const StemResult &res, const StemTrack &track) {
+    const string k = key.str();
+    lock_guard<mutex> guard(m_lock);
+    if(!isOpen())
+        return;
+    if(seeded && res.tracked) {
+        // saving is measured against the mean full search of this cache so far
+        double mean_ms = m_header->searched>0 ? m_header->searched_ms/m_header->searched : 0;
+        double saved = std::max(0.0,mean_ms-res.elapsed_ms);
+        m_stats.seeded++;
+        m_stats.saved_ms += saved;
+        m_header->seeded++;
+        m_header->saved_ms += saved;
+    }
+    else if(res.status!=STEM_LOAD_FAILED) {
+        m_stats.searched++;
+        m_stats.searched_ms += res.elapsed_ms;
+        m_header->searched++;
+        m_header->searched_ms += res.elapsed_ms;
+    }
+    if(res.status!=STEM_OK || !track.valid || track.equalization.total()!=256)
+        return;
+    const uint64_t hash = keyHash(k);
+    Entry *e = find(hash,k,true);
+    e->hash = hash;
+    strncpy(e->key,k.c_str(),sizeof(e->key)-1);
+    e->key[sizeof(e->key)-1] = 0;
+    e->updated = time(nullptr);
+    e->hang_line_row = track.hang_line_row;
+    e->hang_line_x = track.hang_line_x;
+    e->plant_top = track.plant_top;
+    e->stem_area[0] = track.stem_area.x;
+    e->stem_area[1] = track.stem_area.y;
+    e->stem_area[2] = track.stem_area.width;
+    e->stem_area[3] = track.stem_area.height;
+    e->stem_width_px = res.stem_width_px;
+    Mat lut = track.equalization.isContinuous() ? track.equalization : track.equalization.clone();
+    memcpy(e->equalization,lut.data,sizeof(e->equalization));
+}
+RoiCacheStats RoiCache::stats() const {
+    lock_guard<mutex> guard(m_lock);
+    return m_stats;
+}
+RoiCacheStats RoiCache::cumulativeStats() const {
+    lock_guard<mutex> guard(m_lock);
+    RoiCacheStats st;
+    if(!m_header)
+        return st;
+    st.lookups = m_header->lookups;
+    st.hits = m_header->hits;
+    st.stale = m_header->stale;
+    st.seeded = m_header->seeded;
+    st.searched = m_header->searched;
+    st.searched_ms = m_header->searched_ms;
+    st.saved_ms = m_header->saved_ms;
+    return st;
+}
+StemResult measureCached(StemMeasurer &measurer, const Mat &pic, const string &path, RoiCache &cache) {
+    PlantKey key;
+    if(!cache.isOpen() || !parsePlantKey(path,key))
+        return measurer.measureDecoded(pic,path);
+    // without an entry the track starts invalid, the full search then fills it for the next lap
+    StemTrack track;
+    bool seeded = cache.lookup(key,track);
+    StemResult res = measurer.measureDecoded(pic,path,&track);
+    cache.update(key,seeded,res,track);
+    return res;
+}
+void printRoiCacheStats(FILE *out, const RoiCacheStats &stats) {
+    fprintf(out,"roi cache: %llu lookups, %llu hits (%.1f%%), %llu stale, %llu seeded searches, %.2f s saved",
+            (unsigned long long)stats.lookups,(unsigned long long)stats.hits,100*stats.hitRate(),
+            (unsigned long long)stats.stale,(unsigned long long)stats.seeded,stats.saved_ms/1000);
+    if(stats.searched>0)
+        fprintf(out,", %.1f ms/full search",stats.searched_ms/stats.searched);
+    fprintf(out,"\n");
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+#include <QtCore/QFile>
+
+#include "StemMeasurer.h"
+
+// Plant identity from an image name [greenhouse_id]_[lane_id]_[sequence_id]_[side]_[date]_[image_type].jpeg, see
+// machine_vision-master/docs/notes.md. The date ( or lap id ) and image type are not part of the identity.
+struct PlantKey
+{
+    std::string greenhouse;
+    std::string lane;
+    std::string sequence;
+    std::string side;
+
+    std::string str() const { return greenhouse+'_'+lane+'_'+sequence+'_'+side; }
+};
+// false if the file name of path does not follow the naming scheme
+bool parsePlantKey(const std::string &path, PlantKey &key);
+
+struct RoiCacheStats
+{
+    uint64_t lookups     = 0;
+    uint64_t hits        = 0; // entries found and fresh
+    uint64_t stale       = 0; // entries found but too old
+    uint64_t seeded      = 0; // hits whose seeded search succeeded, the rest fell back to the full search
+    uint64_t searched    = 0; // full searches, with their time below
+    double   searched_ms = 0;
+    double   saved_ms    = 0; // mean full search time minus the seeded search time, summed over seeded images
+
+    double hitRate() const { return lookups > 0 ? double(hits) / lookups : 0; }
+};
+
+// Wire, plant top and stem window of every plant from the previous lap, so that the next lap starts its search
+// around them. The table lives in a memory mapped file of fixed capacity ( open addressing, the oldest entry of a
+// probe run is replaced when the run is full ) and keeps cumulative statistics next to it. An instance may be
+// shared by the workers of one process; the file must not be used by two processes at once.
+class RoiCache
+{
+public:
+    RoiCache();
+    ~RoiCache();
+
+    // Creates the file if needed. An existing file made with another capacity or layout is started over.
+    bool open(const std::string &path, size_t capacity = 16384, int max_age_hours = 24*7);
+    void close();
+    bool isOpen() const { return m_entries != nullptr; }
+
+    // track from the entry of key, false when there is none or it is older than max_age_hours
+    bool lookup(const PlantKey &key, StemTrack &track);
+    // Result of measuring key's image; a successful one replaces the entry. seeded tells if lookup succeeded.
+    void update(const PlantKey &key, bool seeded, const StemResult &res, const StemTrack &track);
+
+    RoiCacheStats stats() const;            // since open
+    RoiCacheStats cumulativeStats() const;  // kept in the file
+
+private:
+    struct Header;
+    struct Entry;
+    Entry *find(uint64_t hash, const std::string &key, bool for_insert);
+
+    QFile         m_file;
+    Header       *m_header;
+    Entry        *m_entries;
+    size_t        m_capacity;
+    int64_t       m_max_age_s;
+    RoiCacheStats m_stats;
+    mutable std::mutex m_lock;
+};
+
+// measureDecoded seeded from the cache entry of path's plant, updating the entry. Paths outside the naming scheme
+// are measured without the cache.
+StemResult measureCached(StemMeasurer &measurer, const cv::Mat &pic, const std::string &path, RoiCache &cache);
+
+void printRoiCacheStats(FILE *out, const RoiCacheStats &stats);
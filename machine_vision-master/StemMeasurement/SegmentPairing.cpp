@@ -0,0 +1,189 @@
+#include "SegmentPairing.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+static float DistanceSquared(Point v0,Point v1,float X, float Y)
+{
+    float vx = v0.x - X, vy = v0.y - Y, ux = v1.x - v0.x, uy = v1.y - v0.y;
+    float length = ux * ux + uy * uy;
+
+    float det = (-vx * ux) + (-vy * uy); //if this is < 0 or > length then its outside the line segment
+    if (det < 0)
+        return (v0.x - X) * (v0.x - X) + (v0.y - Y) * (v0.y - Y);
+    if (det > length)
+        return (v1.x - X) * (v1.x - X) + (v1.y - Y) * (v1.y - Y);
+
+    det = ux * vy - uy * vx;
+    return (det * det) / length;
+}
+static bool in_range_inclusive(float s,float e,float v,float w) {
+    float s1 = std::min(s,e);
+    float e1 = std::max(s,e);
+    float v1 = std::min(v,w);
+    float w1 = std::max(v,w);
+    return (e1>v1) && (s1<w1);
+}
+static bool overlapY(Point v0,Point v1,const Vec4i &other) {
+
+    return in_range_inclusive(v0.y,v1.y,other[1],other[3]);
+}
+static bool isLeft(Point a, Point b, Point c){
+    return ((b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x)) > 0;
+}
+static bool linesCross(Point v0,Point v1,const Vec4i &other) {
+    Point o1(other[0],other[1]),o2(other[2],other[3]);
+    return isLeft(v0,v1,o1)!=isLeft(v0,v1,o2);
+}
+
+SegmentPairer::SegmentPairer(float max_distance,float min_distance,float max_tilt_deg)
+    : m_max_distance(max_distance), m_min_distance(min_distance), m_max_tilt(max_tilt_deg*(M_PI/180)) {
+}
+void SegmentPairer::pair(vector<Vec4i> &lines,vector<std::pair<Vec4i,Vec4i> > &pairs) {
+    m_stats = SegmentPairingStats();
+    m_stats.segments = lines.size();
+    // half degree buckets of the segments within m_max_tilt of vertical
+    const double best_angle = M_PI/2;
+    vector<std::pair<int,int> > by_angle; // bucket key, position in lines
+    size_t kept = 0;
+    for(size_t i=0; i<lines.size(); ++i) {
+        const Vec4i &ln(lines[i]);
+        double angle;
+        if(fabs(ln[0]-ln[3])<0.0001)
+            angle = best_angle;
+        else
+            angle = atan(fabs(ln[1]-ln[3])/fabs(ln[0]-ln[2]));
+        if((angle<(best_angle-m_max_tilt)) || (angle>(best_angle+m_max_tilt)))
+            continue;
+        int deg = 2*(angle*180/M_PI);
+        assert(deg>0);
+        by_angle.push_back(make_pair(deg,int(kept)));
+        lines[kept++] = ln;
+    }
+    lines.resize(kept);
+    m_stats.vertical = kept;
+    std::stable_sort(by_angle.begin(),by_angle.end(),
+                     [](const std::pair<int,int> &a,const std::pair<int,int> &b) { return a.first<b.first; });
+    const int n = by_angle.size();
+    m_segments.resize(n);
+    m_bucket.resize(n);
+    int buckets = 0;
+    for(int i=0; i<n; ++i) {
+        if(i>0 && by_angle[i].first!=by_angle[i-1].first)
+            buckets++;
+        m_segments[i] = lines[by_angle[i].second];
+        m_bucket[i] = buckets;
+    }
+    buckets = n>0 ? buckets+1 : 0;
+    m_bucket_prev.resize(buckets);
+    m_bucket_next.resize(buckets);
+    for(int b=0; b<buckets; ++b) {
+        m_bucket_prev[b] = b>0 ? b-1 : buckets-1;
+        m_bucket_next[b] = b+1<buckets ? b+1 : 0;
+    }
+    m_alive.assign(n,1);
+    m_seen.assign(n,-1);
+    buildGrid();
+
+    // a pair is closer than m_max_distance on average, so one of the end points of the partner is that close to
+    // the segment and lies in the cells around its bounding box
+    const int reach = int(ceil(m_max_distance))+1;
+    for(int i=0; i<n; ++i) {
+        if(!m_alive[i])
+            continue;
+        const Vec4i &s(m_segments[i]);
+        Point v0(s[0],s[1]),v1(s[2],s[3]);
+        const int b = m_bucket[i];
+        int cx0 = std::max(0,(std::min(s[0],s[2])-reach-m_origin.x)/m_cell);
+        int cx1 = std::min(m_cols-1,(std::max(s[0],s[2])+reach-m_origin.x)/m_cell);
+        int cy0 = std::max(0,(std::min(s[1],s[3])-reach-m_origin.y)/m_cell);
+        int cy1 = std::min(m_rows-1,(std::max(s[1],s[3])+reach-m_origin.y)/m_cell);
+        // the quadratic scan took the first of equally close segments, own bucket before the previous and the next
+        double closest = 1000000;
+        int closest_rank = 3;
+        int closest_id = -1;
+        for(int cy=cy0; cy<=cy1; ++cy) {
+            for(int cx=cx0; cx<=cx1; ++cx) {
+                int c = cy*m_cols+cx;
+                for(int k=m_cell_start[c]; k<m_cell_start[c+1]; ++k) {
+                    int j = m_cell_ids[k];
+                    if(j==i || !m_alive[j] || m_seen[j]==i)
+                        continue;
+                    m_seen[j] = i;
+                    int bj = m_bucket[j];
+                    int rank = bj==b ? 0 : bj==m_bucket_prev[b] ? 1 : bj==m_bucket_next[b] ? 2 : 3;
+                    if(rank==3)
+                        continue;
+                    const Vec4i &other(m_segments[j]);
+                    if(linesCross(v0,v1,other))
+                        continue;
+                    if(!overlapY(v0,v1,other))
+                        continue;
+                    m_stats.candidates++;
+                    double dist1 = DistanceSquared(v0,v1,other[0],other[1]);
+                    double dist2 = DistanceSquared(v0,v1,other[2],other[3]);
+                    if((dist1<0) || (dist2<0))
+                        continue;
+                    double avg_dist = (sqrt(dist1)+sqrt(dist2))/2.0;
+                    if(avg_dist<closest || (avg_dist==closest && (rank<closest_rank ||
+                                                                  (rank==closest_rank && j<closest_id)))) {
+                        closest = avg_dist;
+                        closest_rank = rank;
+                        closest_id = j;
+                    }
+                }
+            }
+        }
+        if(closest_id>=0 && closest>m_min_distance && closest<m_max_distance) {
+            pairs.push_back(make_pair(s,m_segments[closest_id]));
+            m_alive[i] = 0;
+            m_alive[closest_id] = 0;
+            m_stats.pairs++;
+        }
+    }
+}
+void SegmentPairer::buildGrid() {
+    const int n = m_segments.size();
+    m_cell = std::max(1,int(ceil(m_max_distance)));
+    if(n==0) {
+        m_cols = m_rows = 0;
+        m_cell_start.assign(1,0);
+        m_cell_ids.clear();
+        return;
+    }
+    int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+    for(const Vec4i &s : m_segments) {
+        x0 = std::min(x0,std::min(s[0],s[2]));
+        x1 = std::max(x1,std::max(s[0],s[2]));
+        y0 = std::min(y0,std::min(s[1],s[3]));
+        y1 = std::max(y1,std::max(s[1],s[3]));
+    }
+    m_origin = Point(x0,y0);
+    m_cols = (x1-x0)/m_cell+1;
+    m_rows = (y1-y0)/m_cell+1;
+    // every segment goes into the cells of its two end points, once if they share one
+    auto cellOf = [&](int x,int y) { return ((y-y0)/m_cell)*m_cols+(x-x0)/m_cell; };
+    m_cell_start.assign(size_t(m_cols)*m_rows+1,0);
+    for(const Vec4i &s : m_segments) {
+        int a = cellOf(s[0],s[1]), b = cellOf(s[2],s[3]);
+        m_cell_start[a+1]++;
+        if(b!=a)
+            m_cell_start[b+1]++;
+    }
+    for(size_t c=1; c<m_cell_start.size(); ++c)
+        m_cell_start[c] += m_cell_start[c-1];
+    m_cell_ids.resize(m_cell_start.back());
+    vector<int> fill(m_cell_start.begin(),m_cell_start.end()-1);
+    for(int i=0; i<n; ++i) {
+        const Vec4i &s(m_segments[i]);
+        int a = cellOf(s[0],s[1]), b = cellOf(s[2],s[3]);
+        m_cell_ids[fill[a]++] = i;
+        if(b!=a)
+            m_cell_ids[fill[b]++] = i;
+    }
+}
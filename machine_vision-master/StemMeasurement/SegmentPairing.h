@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+struct SegmentPairingStats
+{
+    size_t segments   = 0; // given to pair()
+    size_t vertical   = 0; // left after dropping the ones tilted too far
+    size_t candidates = 0; // neighbours whose distance was computed
+    size_t pairs      = 0;
+};
+
+// Pairs near vertical Hough segments ( the two sides of a stem ) with their closest neighbour. Segments are bucketed
+// by angle in half degrees; a segment is compared with the segments of its own bucket and of the buckets before and
+// after it that are not on the same side of it and overlap it vertically. The closest one, by the mean distance of
+// its end points, is its pair when that distance is in (min_distance,max_distance). Segments are taken bucket by
+// bucket, and a paired segment is out of the search.
+// The neighbours come from a uniform grid of max_distance cells holding the segment end points, paired segments are
+// only marked dead in it, so pairing is close to linear in the number of segments. Not thread safe; the buffers are
+// reused between calls.
+class SegmentPairer
+{
+public:
+    explicit SegmentPairer(float max_distance = 120, float min_distance = 5, float max_tilt_deg = 8);
+
+    // lines keeps the near vertical segments only, in their order; the pairs are appended
+    void pair(std::vector<cv::Vec4i> &lines, std::vector<std::pair<cv::Vec4i, cv::Vec4i>> &pairs);
+    const SegmentPairingStats &stats() const { return m_stats; }
+
+private:
+    void buildGrid();
+
+    float                  m_max_distance;
+    float                  m_min_distance;
+    double                 m_max_tilt;
+    SegmentPairingStats    m_stats;
+    std::vector<cv::Vec4i> m_segments;    // by bucket, then in their order in lines
+    std::vector<int>       m_bucket;      // bucket index of each segment
+    std::vector<int>       m_bucket_prev; // neighbouring buckets, the first and last wrap around
+    std::vector<int>       m_bucket_next;
+    std::vector<char>      m_alive;
+    std::vector<int>       m_seen;        // query stamp of each segment, a segment sits in up to two cells
+    cv::Point              m_origin;
+    int                    m_cell  = 1;
+    int                    m_cols  = 0;
+    int                    m_rows  = 0;
+    std::vector<int>       m_cell_start; // CSR, cell c holds m_cell_ids[m_cell_start[c],m_cell_start[c+1])
+    std::vector<int>       m_cell_ids;
+};
@@ -0,0 +1,165 @@
+#include "StageGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+#include <opencv2/core/core.hpp>
+
+using namespace std;
+
+namespace {
+typedef chrono::steady_clock Clock;
+
+// The tasks of one wave, each a chain of stages
+class TaskWave : public cv::ParallelLoopBody
+{
+public:
+    typedef std::function<void(int)> Body;
+    explicit TaskWave(const Body &body) : m_body(body) {}
+    void operator()(const cv::Range &r) const {
+        for(int i=r.start; i<r.end; ++i)
+            m_body(i);
+    }
+
+private:
+    Body m_body;
+};
+}
+
+void mergeStageTimes(StageTimes &into,const StageTimes &from) {
+    for(const auto &entry : from) {
+        StageTime &t(into[entry.first]);
+        t.total_ms += entry.second.total_ms;
+        t.runs += entry.second.runs;
+    }
+}
+void printStageTimes(FILE *out,const StageTimes &times,size_t images) {
+    for(const auto &entry : times) {
+        const StageTime &t(entry.second);
+        fprintf(out,"step  %-20s %7zu runs, %8.3f ms/run, %8.3f ms/image\n",entry.first.c_str(),t.runs,
+                t.runs>0 ? t.total_ms/t.runs : 0,images>0 ? t.total_ms/images : 0);
+    }
+}
+
+void StageGraph::clear() {
+    m_declared = 0;
+}
+StageGraph &StageGraph::stage(const char *name,initializer_list<const char *> inputs,
+                              initializer_list<const char *> outputs,const Body &body) {
+    if(m_stages.size()<=m_declared)
+        m_stages.resize(m_declared+1);
+    Stage &s(m_stages[m_declared++]);
+    s.name = name;
+    s.inputs.assign(inputs.begin(),inputs.end());
+    s.outputs.assign(outputs.begin(),outputs.end());
+    s.body = body;
+    return *this;
+}
+int StageGraph::producer(const string &buffer) const {
+    for(size_t i=0; i<m_declared; ++i) {
+        for(const string &o : m_stages[i].outputs)
+            if(o==buffer)
+                return int(i);
+    }
+    return -1;
+}
+void StageGraph::run(initializer_list<const char *> outputs,StageTimes *times) {
+    const int n = m_declared;
+    // the stages the requested buffers depend on, with the needed stages each of them waits for and feeds
+    vector<char> needed(n,0);
+    vector<vector<int> > preds(n), succs(n);
+    vector<int> pending;
+    for(const char *o : outputs) {
+        int p = producer(o);
+        if(p<0)
+            CV_Error(CV_StsBadArg,string("no stage writes ")+o);
+        pending.push_back(p);
+    }
+    while(!pending.empty()) {
+        int s = pending.back();
+        pending.pop_back();
+        if(needed[s])
+            continue;
+        needed[s] = 1;
+        for(const string &in : m_stages[s].inputs) {
+            int p = producer(in);
+            if(p<0 || std::find(preds[s].begin(),preds[s].end(),p)!=preds[s].end())
+                continue;
+            preds[s].push_back(p);
+            succs[p].push_back(s);
+            pending.push_back(p);
+        }
+    }
+    // a stage waiting for a single stage that feeds nothing else continues the chain of that stage
+    auto continues = [&](int s) { return preds[s].size()==1 && succs[preds[s][0]].size()==1; };
+    vector<vector<int> > chains;
+    vector<int> chain_of(n,-1);
+    size_t chained = 0;
+    for(int s=0; s<n; ++s) {
+        if(!needed[s] || continues(s))
+            continue;
+        chains.push_back(vector<int>(1,s));
+        chain_of[s] = chains.size()-1;
+        for(int c=s; succs[c].size()==1 && continues(succs[c][0]);) {
+            c = succs[c][0];
+            chains.back().push_back(c);
+            chain_of[c] = chains.size()-1;
+        }
+        chained += chains.back().size();
+    }
+    if(chained!=size_t(std::count(needed.begin(),needed.end(),1)))
+        CV_Error(CV_StsError,"stage graph has a cycle");
+
+    m_ms.assign(n,0);
+    vector<char> done(chains.size(),0);
+    vector<int> wave;
+    vector<exception_ptr> errors;
+    size_t finished = 0;
+    while(finished<chains.size()) {
+        wave.clear();
+        for(size_t c=0; c<chains.size(); ++c) {
+            bool ready = !done[c];
+            for(int p : preds[chains[c][0]])
+                ready = ready && done[chain_of[p]];
+            if(ready)
+                wave.push_back(c);
+        }
+        if(wave.empty())
+            CV_Error(CV_StsError,"stage graph has a cycle");
+        errors.assign(wave.size(),exception_ptr());
+        TaskWave::Body task = [&](int w) {
+            try {
+                for(int s : chains[wave[w]]) {
+                    Clock::time_point start = Clock::now();
+                    m_stages[s].body();
+                    m_ms[s] = chrono::duration<double,milli>(Clock::now()-start).count();
+                }
+            }
+            catch(...) {
+                errors[w] = current_exception();
+            }
+        };
+        if(wave.size()==1)
+            task(0);
+        else
+            cv::parallel_for_(cv::Range(0,wave.size()),TaskWave(task));
+        for(const exception_ptr &e : errors)
+            if(e)
+                rethrow_exception(e);
+        for(int c : wave)
+            done[c] = 1;
+        finished += wave.size();
+    }
+    m_ran = 0;
+    for(int s=0; s<n; ++s) {
+        if(!needed[s])
+            continue;
+        m_ran++;
+        if(times) {
+            StageTime &t((*times)[m_stages[s].name]);
+            t.total_ms += m_ms[s];
+            t.runs++;
+        }
+    }
+}
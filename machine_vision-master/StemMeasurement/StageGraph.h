@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <vector>
+
+struct StageTime
+{
+    double total_ms = 0;
+    size_t runs     = 0;
+};
+typedef std::map<std::string, StageTime> StageTimes;
+
+void mergeStageTimes(StageTimes &into, const StageTimes &from);
+// One line per stage, its mean time per run and per image
+void printStageTimes(FILE *out, const StageTimes &times, size_t images);
+
+// A processing step declared as named stages that read and write named buffers. run() executes only the stages
+// the requested buffers depend on, each once and timed. Chains of stages that depend on nothing else run as one task;
+// tasks whose inputs are ready run concurrently on OpenCV's thread pool.
+// The workspace and ImageContext are not thread safe: take the workspace buffers while declaring the stages, and
+// compute the context planes two concurrent tasks would both need in a stage they both depend on.
+class StageGraph
+{
+public:
+    typedef std::function<void()> Body;
+
+    void clear();
+    // A buffer no stage writes is an input of the graph, always ready
+    StageGraph &stage(const char *name, std::initializer_list<const char *> inputs,
+                      std::initializer_list<const char *> outputs, const Body &body);
+    // Times are added to the entry of each stage that ran
+    void run(std::initializer_list<const char *> outputs, StageTimes *times = nullptr);
+    size_t ran() const { return m_ran; } // stages run by the last run()
+
+private:
+    struct Stage
+    {
+        std::string              name;
+        std::vector<std::string> inputs;
+        std::vector<std::string> outputs;
+        Body                     body;
+    };
+    int producer(const std::string &buffer) const;
+
+    std::vector<Stage>  m_stages;
+    size_t              m_declared = 0; // m_stages is reused, only the first m_declared are current
+    size_t              m_ran      = 0;
+    std::vector<double> m_ms;           // of each stage in the last run
+};
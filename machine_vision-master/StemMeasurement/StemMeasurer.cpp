@@ -0,0 +1,824 @@
+#include <cstdio>
+#include <fstream>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/operations.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/ml/ml.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/features2d/features2d.hpp>
+#include <opencv2/ml/ml.hpp>
+//#include "opencv2/gpu/gpu.hpp"
+#include "opencv2/video/video.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/highgui/highgui.hpp"
+//#include "opencv2/videostab/videostab.hpp"
+#include "opencv2/opencv_modules.hpp"
+//#include <fann.h>
+#include <opencv2/ml/ml.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+//#include <fann_cpp.h>
+#include <chrono>
+#include <functional>
+
+#include "BandStream.h"
+#include "ColumnProfile.h"
+#include "DebugSink.h"
+#include "EdgeIndex.h"
+#include "EdgeRuns.h"
+#include "ImageContext.h"
+#include "ImageLoader.h"
+#include "Metrics.h"
+#include "SegmentPairing.h"
+#include "StemMeasurer.h"
+using namespace std;
+using namespace cv;
+
+void StemMeasurer::pairLines(vector<Vec4i> &lines) {
+    m_paired_lines.clear();
+    m_pairer.pair(lines,m_paired_lines);
+    if(m_params.verbose)
+        printf("We have %zu pairs lines \n",m_paired_lines.size());
+}
+const char *stemStatusName(StemStatus st) {
+    switch(st) {
+        case STEM_OK: return "ok";
+        case STEM_LOAD_FAILED: return "load_failed";
+        case STEM_NO_HANG_LINE: return "no_hang_line";
+        case STEM_NO_PLANT_TOP: return "no_plant_top";
+        case STEM_NO_STEM: return "no_stem";
+        case STEM_ERROR: return "error";
+    }
+    return "unknown";
+}
+StemMeasurer::StemMeasurer(const StemParams &params) : m_params(params), m_ws(params) {
+}
+StemResult StemMeasurer::measureFile(const std::string &path) {
+    auto start = std::chrono::steady_clock::now();
+    cv::Mat pic;
+    try {
+        // only the crop area is decoded
+        pic = loadImageRoi(path,m_params.crop_area);
+    }
+    catch(const cv::Exception &e) {
+        cerr << path << ": " << e.what() << '\n';
+    }
+    StemResult res = measureDecoded(pic,path);
+    res.elapsed_ms = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+    return res;
+}
+StemResult StemMeasurer::measureDecoded(const cv::Mat &pic, const std::string &path, StemTrack *track) {
+    auto start = std::chrono::steady_clock::now();
+    DebugImageScope debug_scope(path);
+    StemResult res;
+    if(pic.empty())
+        res.status = STEM_LOAD_FAILED;
+    else {
+        try {
+            if(track)
+                res = measureTracked(pic,*track);
+            else {
+                METRIC_TIMER(STAGE_FRAME);
+                m_ws.beginImage();
+                findHangLine(pic,res);
+                res.allocated_bytes = m_ws.endImage();
+            }
+        }
+        catch(const cv::Exception &e) {
+            cerr << path << ": " << e.what() << '\n';
+            res = StemResult();
+            res.status = STEM_ERROR;
+        }
+    }
+    if(track && res.status!=STEM_OK)
+        track->valid = false;
+    res.elapsed_ms = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+    return res;
+}
+StemResult StemMeasurer::measure(const cv::Mat &pic) {
+    METRIC_TIMER(STAGE_FRAME);
+    auto start = std::chrono::steady_clock::now();
+    StemResult res;
+    m_ws.beginImage();
+    findHangLine(pic,res);
+    res.allocated_bytes = m_ws.endImage();
+    res.elapsed_ms = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+    return res;
+}
+StemResult StemMeasurer::measureTracked(const cv::Mat &pic,StemTrack &track) {
+    METRIC_TIMER(STAGE_FRAME);
+    auto start = std::chrono::steady_clock::now();
+    StemResult res;
+    m_ws.beginImage();
+    if(track.valid && track.tracked_frames<m_params.track_refresh) {
+        track.equalization.copyTo(m_ws.equalization_lut);
+        findHangLineTracked(pic,track,res);
+        // a stem window far from the previous one means the search latched onto something else
+        res.tracked = res.status==STEM_OK && std::abs(res.stem_area.x-track.stem_area.x)<=m_params.track_stem_shift;
+    }
+    if(!res.tracked) {
+        res = StemResult();
+        m_keep_equalization = true;
+        findHangLine(pic,res);
+        m_keep_equalization = false;
+    }
+    res.allocated_bytes = m_ws.endImage();
+    track.valid = res.status==STEM_OK;
+    if(track.valid) {
+        track.hang_line_row = res.hang_line_row;
+        track.hang_line_x = res.hang_line_x;
+        track.plant_top = res.plant_top;
+        track.stem_area = res.stem_area;
+        if(res.tracked)
+            track.tracked_frames++;
+        else {
+            m_ws.equalization_lut.copyTo(track.equalization);
+            track.tracked_frames = 0;
+        }
+    }
+    res.elapsed_ms = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+    return res;
+}
+StemResult StemMeasurer::measureWithMask(const cv::Mat &pic,const cv::Mat &mask) {
+    CV_Assert(mask.size()==pic.size() && mask.type()==CV_8UC1);
+    m_stalk_mask = mask;
+    StemResult res = measure(pic);
+    m_stalk_mask = Mat();
+    return res;
+}
+bool StemMeasurer::verifyStems(pair<int,int> stem_sides,int row,const EdgeIndex &edges,const Mat1b &edge_img,
+                               double &width_max,int &support) {
+    // walk up from current center of stem
+    // verify that width is similar to the one below
+    // if number of correct width checks > 5 calculate stem width
+    LineAccumulator leftSide;
+    LineAccumulator rightSide;
+    int collected_points=45;
+    Point center((stem_sides.second+stem_sides.first)/2,row);
+    float width=stem_sides.second-stem_sides.first;
+    int failed_stem_locations=0;
+    rightSide.add(stem_sides.first,row);
+    leftSide.add(stem_sides.first,row);
+    float start_width = width;
+    for (;failed_stem_locations<4;) {
+        center.y -= 1; // go up one row
+        if(center.y<0)
+            break;
+        int nextRight = edges.nextRight(center.x,center.y,int(center.x+(width/2)+10));
+        int nextLeft = edges.nextLeft(center.x,center.y,int(center.x-(width/2)-10));
+        if(abs((nextRight-nextLeft)-width)>10) {
+            failed_stem_locations++; // to wide or to narrow
+            continue;
+        }
+        rightSide.add(nextRight,center.y);
+        leftSide.add(nextLeft,center.y);
+        center.x = (nextRight+nextLeft)/2;
+        width = nextRight-nextLeft;
+    }
+    if((start_width-width)<-2)
+        return false;
+    if(rightSide.n<collected_points)
+        return false;
+    // parallel test
+    Vec4f rightLine = rightSide.line();
+    Vec4f leftLine = leftSide.line();
+    Vec2f rVec(rightLine(0),rightLine(1));
+    Vec2f lVec(leftLine(0),leftLine(1));
+    Mat hst_merged;
+    //cout << rightLine << ' ' << leftLine << '\n';
+
+    double angle=acos(std::min(1.0,double(rVec.dot(lVec))))*180/M_PI;
+    if((angle>10) && (angle < 350)) {
+        return false;
+    }
+    if(width_max>start_width) {
+        return false;
+    }
+    width_max=start_width;
+    support=rightSide.n;
+    if(DebugSink::instance().enabled(DEBUG_RESULT)) {
+        cvtColor(edge_img,hst_merged,CV_GRAY2RGB);
+        Mat cdst2;
+        cdst2 = hst_merged;
+
+        vector<Vec4i> lines;
+        Point p1(rightLine(2)-90*rVec(0),rightLine(3)- 90*rVec(1));
+        Point p2(p1.x + 180*rVec(0),p1.y + 180*rVec(1));
+        line( cdst2, p1, p2, Scalar(0,0,255), 1, CV_AA);
+
+        Point p3(leftLine(2)-90*lVec(0),leftLine(3)- 90*lVec(1));
+        Point p4(p3.x + 180*lVec(0),p3.y + 180*lVec(1));
+        line( cdst2, p3, p4, Scalar(0,255,0), 1, CV_AA);
+        DEBUG_TAP(DEBUG_RESULT,"res2a",cdst2);
+    }
+    return true;
+}
+float StemMeasurer::stemWidth(ImageContext &area,int *support) {
+    METRIC_TIMER(STAGE_STEM_WIDTH);
+
+    int canny_param=m_params.canny_stem;
+    const Mat &pic = area.base();
+    const Size sz = pic.size();
+    const bool debug_all = DebugSink::instance().enabled(DEBUG_ALL);
+    DEBUG_TAP(DEBUG_STAGES,"search_area",pic);
+
+    // the saturation mask and the Canny edges of the closed area are independent branches, every buffer is taken
+    // before the graph runs them concurrently
+    Mat &hst_merged = m_ws.mat(WS_STEM_CLOSED,sz,pic.type());
+    Mat &saturation_mask = m_ws.mat(WS_STEM_SATURATION_MASK,sz,CV_8UC1);
+    Mat &filter = m_ws.mat(WS_STEM_FILTER,sz,CV_8UC1);
+    Mat &resul_g = m_ws.mat(WS_STEM_GRAY,sz,CV_8UC1);
+    Mat &res_blr = m_ws.mat(WS_STEM_GRAY_BLURRED,sz,CV_8UC1);
+    Mat &canny = m_ws.mat(WS_STEM_CANNY,sz,CV_8UC1);
+    Mat &dst = m_ws.mat(WS_STEM_EDGES,sz,CV_8UC1);
+    // the bilateral filter never reached the edges, it is only run for its debug image
+    Mat *filtered = debug_all ? &m_ws.mat(WS_STEM_FILTERED,sz,pic.type()) : nullptr;
+    const Mat *hsv = nullptr;
+    m_graph.clear();
+    m_graph.stage("stem.bilateral",{},{"filtered"},[&]() { cv::bilateralFilter(pic,*filtered,-1,6,13); })
+           .stage("stem.hsv",{},{"hsv"},[&]() { hsv = &area.hsvFull(); })
+           .stage("stem.saturation",{"hsv"},{"saturation_mask"},[&]() {
+               m_ws.stem_unsaturated.apply(*hsv,saturation_mask);
+           })
+           .stage("stem.erode",{"saturation_mask"},{"filter"},[&]() {
+               m_ws.stem_erode.apply(saturation_mask,filter,MORPH_ERODE);
+           })
+           .stage("stem.close",{},{"closed"},[&]() { m_ws.stem_close.apply(pic,hst_merged,MORPH_CLOSE); })
+           .stage("stem.gray",{"closed"},{"gray"},[&]() { cvtColor(hst_merged,resul_g,CV_RGB2GRAY); })
+           .stage("stem.blur",{"gray"},{"gray_blurred"},[&]() { blur(resul_g,res_blr,Size(3,3)); })
+           .stage("stem.canny",{"gray_blurred"},{"canny"},[&]() {
+               Canny(res_blr, canny, canny_param, canny_param*3, 3,true);
+           })
+           .stage("stem.edge_close",{"canny"},{"edges"},[&]() {
+               m_ws.stem_edge_close.apply(canny,dst,MORPH_CLOSE);
+           })
+           .stage("stem.mask_edges",{"edges","filter"},{"stem_edges"},[&]() { dst.setTo(0,filter); });
+    if(debug_all)
+        m_graph.run({"stem_edges","filtered"},&m_stage_times);
+    else
+        m_graph.run({"stem_edges"},&m_stage_times);
+
+    //Mat filter = filterHSV(split_planes,256*(76.0f/360.0f),256*(170.0f/360.0f),5,100); // 76 deg - 170 deg
+    //    equalizeHist(split_planes[2],hst);
+    //    split_planes[2] = hst;
+    //    merge(split_planes,pic);
+    //    cvtColor(pic,hst_merged,CV_HSV2RGB_FULL);
+
+    //    cv::bilateralFilter(hst_merged,filtered,-1,13,13);
+    //    hst_merged = filtered;
+    if(filtered)
+        DEBUG_TAP(DEBUG_ALL,"search_area_bilateral",*filtered);
+    DEBUG_TAP(DEBUG_STAGES,"search_area_H",hst_merged);
+    DEBUG_TAP(DEBUG_STAGES,"search_areaH",hst_merged);
+    DEBUG_TAP(DEBUG_STAGES,"search_areaH_FL",filter);
+    DEBUG_TAP(DEBUG_STAGES,"search_areaHE",dst);
+    return stemWidthFromEdges(dst,support);
+}
+float StemMeasurer::maskStemWidth(const Mat &mask,int *support) {
+    METRIC_TIMER(STAGE_STEM_WIDTH);
+    // the stem sides are where the stalk mask turns on and off along each row, in place of the Canny edges
+    Mat1b dst = m_ws.mat(WS_STEM_EDGES,mask.size(),CV_8UC1);
+    for(int y=0; y<mask.rows; ++y) {
+        const uchar *m = mask.ptr<uchar>(y);
+        uchar *d = dst.ptr<uchar>(y);
+        bool prev = m[0]>127;
+        d[0] = 0;
+        for(int x=1; x<mask.cols; ++x) {
+            bool cur = m[x]>127;
+            d[x] = cur!=prev ? 255 : 0;
+            prev = cur;
+        }
+    }
+    DEBUG_TAP(DEBUG_STAGES,"search_area_mask",dst);
+    return stemWidthFromEdges(dst,support);
+}
+float StemMeasurer::stemWidthFromEdges(const Mat1b &dst,int *support) {
+    METRIC_TIMER(STAGE_VERIFY);
+    // 45 is the number of checked stem parts
+    EdgeIndex &edge_index(m_ws.stem_edge_index);
+    edge_index.build(dst);
+    vector<EdgeRun> stem_starts;
+    int verified_support = 0;
+    if(dst.rows-1>45)
+        StemRunScanner::scanRows(dst,dst.rows-1,46,stem_starts);
+    METRIC_COUNT(COUNT_STEM_CANDIDATES,stem_starts.size());
+    for(size_t k=0; k<stem_starts.size();) {
+        int row = stem_starts[k].row;
+        bool verified=false;
+        double width=0;
+        size_t first = k;
+        for(; k<stem_starts.size() && stem_starts[k].row==row; ++k) {
+            //cout << "Possible stem at " << row << " " << stem_starts[k].start << ' ' << stem_starts[k].end <<'\n';
+            verified|=verifyStems(make_pair(stem_starts[k].start,stem_starts[k].end),row,edge_index,dst,width,
+                                  verified_support);
+        }
+        METRIC_COUNT(COUNT_CANDIDATE_ROWS,1);
+        METRIC_COUNT(COUNT_VERIFY_CALLS,k-first);
+        if(verified) {
+            METRIC_COUNT(COUNT_STEMS_VERIFIED,1);
+            if(support)
+                *support = verified_support;
+            return width;
+        }
+    }
+    return 0;
+}
+static bool greenAt(const Mat3b &pic,int x,int y,int minDiff=4) {
+    cv::Vec3b sc = pic(y,x);
+    double max_othe = std::max(sc(0),sc(2));
+    return sc(1)>(max_othe+minDiff);
+}
+void StemMeasurer::trimToGreen(Rect &r,const Mat3b &pic_) {
+    METRIC_TIMER(STAGE_TRIM);
+    DEBUG_TAP(DEBUG_STAGES,"gg",pic_(r));
+    Mat3b pic = m_ws.mat(WS_TRIM_BLURRED,r.size(),CV_8UC3);
+    blur(pic_(r),pic,Size(3,3));
+    ColumnProfile &profile(m_ws.trim_profile);
+    profile.build(pic);
+    // first column green on average, then back to where the green pixels around it start
+    int left=std::max(r.width-1,0);
+    for(int x=0; x<r.width; ++x ) {
+        if(profile.meanIsGreen(x)) {
+            left=x;
+            break;
+        }
+    }
+    if(left>0)
+        left = std::max(profile.lastWithoutGreen(left),0);
+    if(left>200) {
+        int max_left=left;
+        left = std::min(profile.nextWithGreen(left-200),max_left);
+        if(m_params.verbose)
+            printf("Trimmed %d\n",left);
+        r.x += left;
+        r.width-=left;
+    }
+}
+static bool brighter(Scalar a,Scalar b) {
+    return (a(0)+a(1)+a(2)) > (b(0)+b(1)+b(2));
+}
+static int centerOfBrightestLine(vector<pair<int,int> > &lines,Mat &pic) {
+    Mat r0(pic.row(0));
+    Scalar max_val(0,0,0,0);
+    int max_idx=0;
+    int idx=0;
+    for(pair<int,int> & ln : lines) {
+        Scalar current = mean(r0.colRange(ln.first,ln.second));
+        if(brighter(current,max_val)) {
+            max_val = current;
+            max_idx=idx;
+        }
+        idx++;
+    }
+    return (lines[max_idx].first+lines[max_idx].second)/2;
+}
+static int highestGreenCrossingTheLine(int line_center,const cv::Mat &pic,const Mat &edges);
+int StemMeasurer::findHangLine(const cv::Mat &src,StemResult &res) {
+    if(m_params.coarse_scale>1)
+        return findHangLineCoarse(src,res);
+    //Mat elementS = getStructuringElement( MORPH_RECT, Size( 2*morph_size + 1, 2*morph_size+1 ), Point( morph_size, morph_size ) );
+    // every derived plane below, and the ones stemWidth needs, come from this context
+    ImageContext ctx(Mat(),&m_ws);
+    const Mat &pic = prepareFrame(src,ctx);
+    DEBUG_TAP(DEBUG_STAGES,"bling",pic);
+    const Mat &hst_merged = ctx.equalizedRgb();
+    DEBUG_TAP(DEBUG_STAGES,"blingH",hst_merged);
+    if(m_keep_equalization)
+        ctx.equalization().copyTo(m_ws.equalization_lut);
+    //cout << minval << " - " << maxVal << '\n';
+    //    cout << split_planes[0].rowRange(549,554).colRange(400,420) << '\n';
+    const Mat &dst = wireEdges(ctx);
+    vector<pair<int,int> > line_starts;
+    int start_row = findWireRow(dst,line_starts,res);
+    if(start_row<0)
+        return res.status;
+    res.hang_line_row = start_row;
+    Mat hst_rows = hst_merged.rowRange(start_row,hst_merged.rows);
+    int center_of_line = centerOfBrightestLine(line_starts,hst_rows);
+    res.hang_line_x = center_of_line;
+    //cout << "Center line is at " <<  center_of_line << '\n';
+    int plant_top = highestGreenCrossingTheLine(center_of_line,hst_rows,dst);
+    if(plant_top==-1) {
+        if(m_params.verbose)
+            cout << " Failed to find top of the plant\n";
+        res.status = STEM_NO_PLANT_TOP;
+        return res.status;
+    }
+    if(m_params.verbose)
+        cout << "Plant top at " <<  plant_top << '\n';
+    res.plant_top = start_row+plant_top;
+    Rect selected_area;
+    if(!stemWindow(plant_top,hst_rows.size(),selected_area,res))
+        return res.status;
+    return measureStem(ctx,0,start_row,selected_area,res);
+    //    cv::imwrite("edg.png",edges(selected_area));
+    //    hst_merged.setTo(0,hsv_mask);
+    //    cv::imwrite("top.png",hst_merged);
+}
+const Mat &StemMeasurer::wireEdges(ImageContext &ctx) {
+    METRIC_TIMER(STAGE_WIRE_EDGES);
+    const Size sz = ctx.size();
+    //resul.setTo(0,(split_planes[2]<200) | (split_planes[1]>25) | (split_planes[0]>245) | (split_planes[0]<65) );
+    //resul.setTo(0,(split_planes[2]<190) | (split_planes[1]>65) | (split_planes[0]>160) );
+    //resul.setTo(0,(split_planes[2]<190) | (split_planes[1]>55) | (split_planes[0]>160) | (split_planes[0]<65) );
+    Mat &wire_mask = m_ws.mat(WS_WIRE_MASK,sz,CV_8UC1);
+    Mat &hsv_mask = m_ws.mat(WS_WIRE_MASK_CLOSED,sz,CV_8UC1);
+    Mat &dst = m_ws.mat(WS_EDGES_MASKED,sz,CV_8UC1);
+    const Mat *hsv_equalized = nullptr;
+    const Mat *edges = nullptr;
+    // the wire mask and the Canny edges both start from the equalized HSV plane, which is computed first; the edges
+    // branch is then the only one using the context and the workspace
+    m_graph.clear();
+    m_graph.stage("wire.equalize",{},{"hsv_equalized"},[&]() { hsv_equalized = &ctx.equalizedHsv(); })
+           .stage("wire.mask",{"hsv_equalized"},{"wire_mask"},[&]() {
+               m_ws.wire_rejection.apply(*hsv_equalized,wire_mask);
+           })
+           .stage("wire.mask_close",{"wire_mask"},{"wire_mask_closed"},[&]() {
+               m_ws.hang_line_close.apply(wire_mask,hsv_mask,MORPH_CLOSE);
+           })
+           .stage("wire.edges",{"hsv_equalized"},{"edges"},[&]() { edges = &ctx.edges(m_params.canny_hang_line); })
+           .stage("wire.mask_edges",{"edges","wire_mask_closed"},{"edges_masked"},[&]() {
+               // masked copy, the context keeps the unmasked edges
+               edges->copyTo(dst);
+               dst.setTo(0,hsv_mask);
+           });
+    m_graph.run({"edges_masked"},&m_stage_times);
+    DEBUG_TAP(DEBUG_STAGES,"edg1",*edges);
+    DEBUG_TAP(DEBUG_STAGES,"edg",dst);
+    //resul.setTo(0,(split_planes[2]<100) | (split_planes[1]>15) | (split_planes[0]>195) | (split_planes[0]<65) );
+    //resul.setTo(0,(split_planes[2]<200));
+    //    for(int x=0; x<pic.rows/3; ++x) {
+    //        result1.push_back(resul);
+    //    }
+    DEBUG_TAP(DEBUG_ALL,"input",dst);
+    return dst;
+}
+int StemMeasurer::findWireRow(const Mat &edges,vector<pair<int,int> > &line_starts,StemResult &res) {
+    METRIC_TIMER(STAGE_WIRE_ROW);
+    int start_row = WireRunScanner::firstRowWithRuns(edges,0,std::min(m_params.hang_line_rows,edges.rows),line_starts);
+    METRIC_COUNT(COUNT_WIRE_CANDIDATES,line_starts.size());
+    if(line_starts.empty()) {
+        if(m_params.verbose)
+            cout << " No hang line found\n";
+        res.status = STEM_NO_HANG_LINE;
+        return -1;
+    }
+    return start_row;
+}
+bool StemMeasurer::stemWindow(int plant_top,Size area,Rect &selected_area,StemResult &res) {
+    // area and plant_top are relative to the row of the wire
+    int thirty_centimeters_down=m_params.stem_offset_mm/pixelToMm();
+    selected_area = Rect(0,plant_top+thirty_centimeters_down-m_params.stem_window_rows/2,area.width,
+                         m_params.stem_window_rows);
+    selected_area &= Rect(Point(0,0),area);
+    if(selected_area.height<=45) { // stem search needs more rows than this
+        res.status = STEM_NO_STEM;
+        return false;
+    }
+    return true;
+}
+int StemMeasurer::measureStem(ImageContext &ctx,int band_y,int start_row,Rect selected_area,StemResult &res) {
+    // ctx holds the frame from row band_y on. trimToGreen looks at selected_area below the wire row, stemWidth at
+    // the same rectangle taken from the top of the frame
+    Rect trim_area = selected_area+Point(0,start_row-band_y);
+    trimToGreen(trim_area,ctx.equalizedRgb());
+    selected_area.x = trim_area.x;
+    selected_area.width = trim_area.width;
+    res.stem_area = selected_area;
+    // the window planes go to this measurer's workspace, ctx may belong to the measurer of the whole frame
+    ImageContext stem_area = ctx.roi(selected_area-Point(0,band_y),&m_ws);
+    if(m_stalk_mask.empty())
+        res.stem_width_px = stemWidth(stem_area,&res.stem_support);
+    else
+        res.stem_width_px = maskStemWidth(m_stalk_mask(selected_area),&res.stem_support);
+    res.stem_width_mm = res.stem_width_px*pixelToMm();
+    res.status = res.stem_width_px>0 ? STEM_OK : STEM_NO_STEM;
+    return res.status;
+}
+Mat StemMeasurer::medianBand(const Mat &src,const Rect &r,WorkspaceSlot slot) {
+    // 3x3 median of r, computed with a one pixel margin so that it equals the same part of the whole frame median
+    Rect margin = Rect(r.x-1,r.y-1,r.width+2,r.height+2) & Rect(0,0,src.cols,src.rows);
+    Mat &pic = m_ws.mat(slot,margin.size(),src.type());
+    medianBlur(src(margin),pic,3);
+    return pic(r-margin.tl());
+}
+int StemMeasurer::greenRowInColumn(const Mat &src,int x,int from,int to) {
+    // the rows of highestGreenCrossingTheLine in [from,to), computed for the single column only
+    if(from>=to)
+        return -1;
+    ImageContext column(medianBand(src,Rect(x,from,1,to-from),WS_COLUMN_MEDIAN));
+    column.setEqualization(m_ws.equalization_lut);
+    const Mat3b rgb(column.equalizedRgb());
+    for(int y=0; y<rgb.rows; ++y) {
+        if(greenAt(rgb,0,y))
+            return from+y;
+    }
+    return -1;
+}
+int StemMeasurer::findHangLineCoarse(const cv::Mat &src,StemResult &res) {
+    const int scale = m_params.coarse_scale;
+    Mat &small = m_ws.mat(WS_COARSE,Size(std::max(1,src.cols/scale),std::max(1,src.rows/scale)),src.type());
+    resize(src,small,small.size(),0,0,INTER_AREA);
+    ImageContext &coarse(m_ws.coarse);
+    coarse.reset(small);
+    // full resolution bands are equalized with the histogram of the reduced frame, not of the whole full one
+    coarse.equalization().copyTo(m_ws.equalization_lut);
+    const Mat3b coarse_rgb(coarse.equalizedRgb());
+    DEBUG_TAP(DEBUG_STAGES,"coarse",coarse_rgb);
+
+    // the wire is only looked for in the top rows, they are processed at full resolution with a few rows of margin
+    // for the median, the closing and Canny
+    const int top_rows = std::min(src.rows,m_params.hang_line_rows+16);
+    ImageContext top(medianBand(src,Rect(0,0,src.cols,top_rows),WS_MEDIAN),&m_ws);
+    top.setEqualization(m_ws.equalization_lut);
+    vector<pair<int,int> > line_starts;
+    int start_row = findWireRow(wireEdges(top),line_starts,res);
+    if(start_row<0)
+        return res.status;
+    res.hang_line_row = start_row;
+    Mat hst_rows = top.equalizedRgb().rowRange(start_row,top_rows);
+    int center_of_line = centerOfBrightestLine(line_starts,hst_rows);
+    res.hang_line_x = center_of_line;
+
+    // first green pixel under the wire on the reduced frame, the exact row comes from the full resolution rows
+    // around it
+    int cx = std::min(center_of_line*coarse_rgb.cols/src.cols,coarse_rgb.cols-1);
+    int cy = start_row*coarse_rgb.rows/src.rows;
+    while(cy<coarse_rgb.rows && !greenAt(coarse_rgb,cx,cy))
+        cy++;
+    int plant_top = -1;
+    if(cy<coarse_rgb.rows) {
+        int from = std::max(start_row,(cy-1)*src.rows/coarse_rgb.rows);
+        plant_top = plantTopNear(src,center_of_line,start_row,from,std::min(src.rows,from+3*scale));
+    }
+    if(plant_top==-1) {
+        if(m_params.verbose)
+            cout << " Failed to find top of the plant\n";
+        res.status = STEM_NO_PLANT_TOP;
+        return res.status;
+    }
+    plant_top -= start_row;
+    if(m_params.verbose)
+        cout << "Plant top at " <<  plant_top << '\n';
+    res.plant_top = start_row+plant_top;
+    Rect selected_area;
+    if(!stemWindow(plant_top,Size(src.cols,src.rows-start_row),selected_area,res))
+        return res.status;
+    return measureStemBand(src,start_row,selected_area,res);
+}
+int StemMeasurer::findHangLineTracked(const cv::Mat &src,const StemTrack &track,StemResult &res) {
+    // the wire is looked for in the rows and columns around its previous position, the band adds a margin for the
+    // median, the closing and Canny. Bands are equalized with the LUT of the last fully searched frame.
+    const int margin = 16;
+    const int shift = m_params.track_wire_shift;
+    const int first_row = std::max(0,track.hang_line_row-shift);
+    const int last_row = std::min(std::min(m_params.hang_line_rows,src.rows),track.hang_line_row+shift+1);
+    const int left = std::max(0,track.hang_line_x-shift);
+    const int right = std::min(src.cols,track.hang_line_x+shift+1);
+    res.status = STEM_NO_HANG_LINE;
+    if(first_row>=last_row || left>=right)
+        return res.status;
+    Rect band = Rect(left-margin,first_row-margin,right-left+2*margin,last_row-first_row+2*margin) &
+                Rect(0,0,src.cols,src.rows);
+    ImageContext wire(medianBand(src,band,WS_MEDIAN),&m_ws);
+    wire.setEqualization(m_ws.equalization_lut);
+    const Mat1b window = wireEdges(wire).colRange(left-band.x,right-band.x);
+    vector<pair<int,int> > line_starts;
+    int row = WireRunScanner::firstRowWithRuns(window,first_row-band.y,last_row-band.y,line_starts);
+    // wire in the first searched row may start above it
+    if(line_starts.empty() || (row==first_row-band.y && first_row>0))
+        return res.status;
+    const int start_row = band.y+row;
+    res.hang_line_row = start_row;
+    Mat hst_row = wire.equalizedRgb()(Rect(left-band.x,row,right-left,1));
+    int center_of_line = left+centerOfBrightestLine(line_starts,hst_row);
+    res.hang_line_x = center_of_line;
+
+    const int top_shift = m_params.track_top_shift;
+    int from = std::max(start_row,track.plant_top-top_shift);
+    int plant_top = plantTopNear(src,center_of_line,start_row,from,
+                                 std::max(from,std::min(src.rows,track.plant_top+top_shift+1)));
+    if(plant_top==-1) {
+        res.status = STEM_NO_PLANT_TOP;
+        return res.status;
+    }
+    plant_top -= start_row;
+    res.plant_top = start_row+plant_top;
+    Rect selected_area;
+    if(!stemWindow(plant_top,Size(src.cols,src.rows-start_row),selected_area,res))
+        return res.status;
+    return measureStemBand(src,start_row,selected_area,res);
+}
+int StemMeasurer::plantTopNear(const Mat &src,int x,int start_row,int from,int to) {
+    METRIC_TIMER(STAGE_PLANT_TOP);
+    // first green row of column x below start_row, looked for in [from,to) first
+    int plant_top = greenRowInColumn(src,x,from,to);
+    if(plant_top==from && from>start_row) {
+        // green right at the top of the window may start higher
+        int above = greenRowInColumn(src,x,start_row,from);
+        if(above>=0)
+            plant_top = above;
+    }
+    else if(plant_top==-1)
+        plant_top = greenRowInColumn(src,x,to,src.rows);
+    return plant_top;
+}
+int StemMeasurer::measureStemBand(const Mat &src,int start_row,const Rect &selected_area,StemResult &res) {
+    // only the rows measureStem looks at are processed at full resolution, equalized with m_ws.equalization_lut
+    const int band_y = selected_area.y;
+    Rect band(0,band_y,src.cols,start_row+selected_area.height);
+    ImageContext band_ctx(medianBand(src,band,WS_MEDIAN),&m_ws);
+    band_ctx.setEqualization(m_ws.equalization_lut);
+    return measureStem(band_ctx,band_y,start_row,selected_area,res);
+}
+namespace {
+// Measures a range of the plants of one frame, each with its own StemMeasurer so that the stem scratch buffers are
+// not shared
+class PlantSearch : public cv::ParallelLoopBody
+{
+public:
+    typedef std::function<void(int)> Body;
+    explicit PlantSearch(const Body &body) : m_body(body) {}
+    void operator()(const cv::Range &r) const {
+        for(int i=r.start; i<r.end; ++i)
+            m_body(i);
+    }
+
+private:
+    Body m_body;
+};
+}
+vector<StemResult> StemMeasurer::measurePlants(const cv::Mat &pic,const std::string &path) {
+    METRIC_TIMER(STAGE_FRAME);
+    auto start = std::chrono::steady_clock::now();
+    DebugImageScope debug_scope(path);
+    vector<StemResult> plants;
+    if(pic.empty())
+        plants.resize(1);
+    else {
+        try {
+            m_ws.beginImage();
+            findPlants(pic,plants);
+            size_t allocated = m_ws.endImage();
+            for(StemResult &res : plants)
+                res.allocated_bytes += allocated;
+        }
+        catch(const cv::Exception &e) {
+            cerr << path << ": " << e.what() << '\n';
+            plants.assign(1,StemResult());
+            plants[0].status = STEM_ERROR;
+        }
+    }
+    if(pic.empty())
+        plants[0].status = STEM_LOAD_FAILED;
+    double ms = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+    for(StemResult &res : plants)
+        res.elapsed_ms = ms;
+    return plants;
+}
+void StemMeasurer::findWires(const Mat1b &edges,vector<WireTrace> &wires) {
+    METRIC_TIMER(STAGE_WIRE_ROW);
+    // runs of the top rows chained into vertical traces, a run continues a trace whose last run is a few columns
+    // and at most two rows away
+    struct Trace
+    {
+        int row, x, last_row, last_x, hits;
+    };
+    const int rows = std::min(m_params.hang_line_rows,edges.rows);
+    vector<Trace> traces;
+    vector<pair<int,int> > runs;
+    for(int y=0; y<rows; ++y) {
+        runs.clear();
+        WireRunScanner::scanRow(edges.ptr<uchar>(y),edges.cols,runs);
+        for(const pair<int,int> &r : runs) {
+            int c = (r.first+r.second)/2;
+            Trace *trace = nullptr;
+            for(Trace &t : traces) {
+                if(t.last_row<y && t.last_row>=y-3 && abs(t.last_x-c)<=6) {
+                    trace = &t;
+                    break;
+                }
+            }
+            if(trace) {
+                trace->last_row = y;
+                trace->last_x = c;
+                trace->hits++;
+            }
+            else {
+                Trace t = {y,c,y,c,1};
+                traces.push_back(t);
+            }
+        }
+    }
+    // the longest traces first, one per wire_separation columns
+    std::sort(traces.begin(),traces.end(),[](const Trace &a,const Trace &b) {
+        return a.hits!=b.hits ? a.hits>b.hits : a.row<b.row;
+    });
+    wires.clear();
+    for(const Trace &t : traces) {
+        if(int(wires.size())>=m_params.max_plants)
+            break;
+        bool separate = true;
+        for(const WireTrace &w : wires)
+            separate &= abs(w.x-t.x)>=m_params.wire_separation;
+        if(!separate || (t.hits<3 && !wires.empty()))
+            continue;
+        WireTrace w = {t.row,t.x,float(t.hits)/(rows-t.row)};
+        wires.push_back(w);
+    }
+    std::sort(wires.begin(),wires.end(),[](const WireTrace &a,const WireTrace &b) { return a.x<b.x; });
+}
+const Mat &StemMeasurer::prepareFrame(const Mat &src,ImageContext &ctx) {
+    // 3x3 median of the frame as the base of ctx, with the planes up to the Canny input when they are streamed
+    if(m_params.band_rows>0)
+        return streamFramePlanes(src,m_ws,ctx,m_params.band_rows);
+    Mat &pic = m_ws.mat(WS_MEDIAN,src.size(),src.type());
+    medianBlur(src,pic,3);
+    ctx.reset(pic);
+    return pic;
+}
+void StemMeasurer::findPlants(const cv::Mat &src,vector<StemResult> &plants) {
+    ImageContext ctx(Mat(),&m_ws);
+    prepareFrame(src,ctx);
+    vector<WireTrace> wires;
+    findWires(wireEdges(ctx),wires);
+    if(wires.empty()) {
+        plants.assign(1,StemResult());
+        plants[0].status = STEM_NO_HANG_LINE;
+        return;
+    }
+    // planes every plant reads are computed before the plants run concurrently, their views are then only read
+    ctx.equalizedRgb();
+    ctx.hsvFull();
+    const int n = wires.size();
+    plants.assign(n,StemResult());
+    while(int(m_plant_measurers.size())<n)
+        m_plant_measurers.emplace_back(new StemMeasurer(m_params));
+    // the plants run on OpenCV's threads, which do not see the debug tag of this one
+    const std::string debug_tag = DebugImageScope::currentTag();
+    PlantSearch search([&](int i) {
+        DebugImageScope debug_scope(debug_tag,"plant",i);
+        int left = i>0 ? (wires[i-1].x+wires[i].x)/2 : 0;
+        int right = i+1<n ? (wires[i].x+wires[i+1].x)/2 : src.cols;
+        StemMeasurer &measurer(*m_plant_measurers[i]);
+        measurer.m_calibration = m_calibration;
+        measurer.m_ws.beginImage();
+        measurer.measurePlant(ctx,wires[i],left,right,plants[i]);
+        plants[i].allocated_bytes = measurer.m_ws.endImage();
+        plants[i].plant = i;
+    });
+    parallel_for_(Range(0,n),search);
+    for(int i=0; i<n; ++i) {
+        mergeStageTimes(m_stage_times,m_plant_measurers[i]->m_stage_times);
+        m_plant_measurers[i]->m_stage_times.clear();
+    }
+}
+void StemMeasurer::measurePlant(ImageContext &ctx,const WireTrace &wire,int left,int right,StemResult &res) {
+    // findHangLine for a single wire, with the stem looked for between left and right
+    res.hang_line_row = wire.row;
+    res.hang_line_x = wire.x;
+    Mat hst_rows = ctx.equalizedRgb().rowRange(wire.row,ctx.size().height);
+    int plant_top = highestGreenCrossingTheLine(wire.x,hst_rows,Mat());
+    if(plant_top==-1) {
+        res.status = STEM_NO_PLANT_TOP;
+        return;
+    }
+    res.plant_top = wire.row+plant_top;
+    Rect selected_area;
+    if(!stemWindow(plant_top,hst_rows.size(),selected_area,res))
+        return;
+    selected_area &= Rect(left,0,right-left,selected_area.y+selected_area.height);
+    if(selected_area.width<=0) {
+        res.status = STEM_NO_STEM;
+        return;
+    }
+    measureStem(ctx,0,wire.row,selected_area,res);
+    // 45 verified rows is the least verifyStems accepts, twice that counts as a fully followed stem
+    float stem = res.status==STEM_OK ? std::min(1.0f,res.stem_support/90.0f) : 0;
+    res.confidence = wire.coverage*stem;
+}
+static int highestGreenCrossingTheLine(int line_center, const Mat &pic, const Mat &edges) {
+    METRIC_TIMER(STAGE_PLANT_TOP);
+    // just walk down until green is encountered
+    const Mat3b rgb(pic);
+    for(int y=0; y<rgb.rows; ++y) {
+        if(greenAt(rgb,line_center,y))
+            return y;
+    }
+    return -1;
+    //    double minval,maxVal;
+    //    Mat result1 = Mat::zeros(1,pic.cols,pic.type());
+    //    Mat resul = pic.rowRange(0,3),masking=pic.rowRange(0,3);
+    //    Mat hsl;
+    //    vector<Mat> split_planes;
+    //    cvtColor(resul,hsl,CV_RGB2HSV_FULL);
+    //    split(hsl,split_planes);
+    //    minMaxLoc(split_planes[0],&minval,&maxVal);
+    //    resul = pic.rowRange(0,3);
+    //    resul.setTo(0,(split_planes[2]<200) | (split_planes[1]>5));
+    //    for(int x=0; x<pic.rows/3; ++x) {
+    //        result1.push_back(resul);
+    //    }
+    //    cv::imwrite("top.png",result1);
+}
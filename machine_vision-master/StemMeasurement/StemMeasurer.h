@@ -0,0 +1,170 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "SegmentPairing.h"
+#include "StageGraph.h"
+#include "StemWorkspace.h"
+
+class ImageContext;
+
+enum StemStatus
+{
+    STEM_OK = 0,
+    STEM_LOAD_FAILED,
+    STEM_NO_HANG_LINE,
+    STEM_NO_PLANT_TOP,
+    STEM_NO_STEM,
+    STEM_ERROR,
+};
+const char *stemStatusName(StemStatus st);
+
+struct StemResult
+{
+    // Outcome of measuring a single image, all positions are relative to the measured crop
+    StemStatus status          = STEM_OK;
+    int        hang_line_x     = -1;
+    int        plant_top       = -1;
+    int        hang_line_row   = -1; // first row the wire was found in
+    cv::Rect   stem_area;            // rows and columns stemWidth measured
+    bool       tracked         = false; // found around the positions of the previous frame, see measureTracked
+    int        plant           = 0;     // left to right index of the plant in the frame, see measurePlants
+    int        stem_support    = 0;     // rows the edges of the verified stem were followed for
+    float      confidence      = 0;     // 0..1, how continuous the wire and the stem edges were ( measurePlants )
+    float      stem_width_px   = 0;
+    float      stem_width_mm   = 0;
+    double     elapsed_ms      = 0;
+    size_t     allocated_bytes = 0; // intermediate buffers allocated for this image, 0 in steady state
+};
+
+struct StemParams
+{
+    cv::Rect crop_area        = cv::Rect(1000, 500, 900, 3700); // part of the camera frame holding the plant
+    int      hang_line_rows   = 100;                            // top rows searched for the hanging wire
+    int      hang_line_morph  = 3;
+    int      canny_hang_line  = 15;
+    int      wire_hue_above   = 205; // HSV_FULL ranges rejected when looking for the wire
+    int      wire_hue_below   = 5;
+    int      wire_saturation  = 65;
+    int      wire_value       = 100;
+    int      stem_close_morph = 11;
+    int      stem_erode_morph = 4;
+    int      stem_saturation  = 40;
+    int      canny_stem       = 13;
+    float    pixel_to_mm      = 3.0f / 9.0f; // 3mm is 9 pixels, used when no calibration is set
+    float    marker_mm        = 50;          // side of the QR codes the calibration images show
+    float    stem_offset_mm   = 300;         // stem is measured this far below the plant top
+    int      stem_window_rows = 100;
+    int      coarse_scale     = 1;     // 4 or 8 finds the wire and plant top on a reduced frame first
+    int      band_rows        = 0;     // 64 to 128 computes the frame planes in strips of this many rows
+    int      track_wire_shift = 24;    // wire movement between frames followed without a full search
+    int      track_top_shift  = 48;    // rows around the previous plant top looked at first
+    int      track_stem_shift = 40;    // stem window movement between frames still trusted
+    int      track_refresh    = 50;    // full search at least every this many tracked frames
+    int      max_plants       = 4;     // wires measurePlants follows in one frame
+    int      wire_separation  = 80;    // wires closer than this are taken for one
+    bool     verbose          = false; // print intermediate findings to stdout
+};
+
+// Positions carried from one frame of a sequence to the next by StemMeasurer::measureTracked
+struct StemTrack
+{
+    bool     valid         = false; // false until a frame was measured, and after a frame failed
+    int      hang_line_row = -1;
+    int      hang_line_x   = -1;
+    int      plant_top     = -1;
+    cv::Rect stem_area;
+    cv::Mat  equalization;          // V plane equalization LUT of the last fully searched frame
+    int      tracked_frames = 0;    // frames measured since the last full search
+};
+
+// Scale of the frames taken from one sensor position, see CalibrationCache
+struct StemCalibration
+{
+    float pixel_to_mm = 0; // 0 - not calibrated
+    bool  valid() const { return pixel_to_mm > 0; }
+};
+
+// Stem measurement pipeline. Every instance owns its scratch state, so separate instances can be used
+// concurrently from separate threads; a single instance is not thread safe.
+class StemMeasurer
+{
+public:
+    explicit StemMeasurer(const StemParams &params = StemParams());
+
+    const StemParams &params() const { return m_params; }
+    // pic is the already cropped plant area
+    StemResult measure(const cv::Mat &pic);
+    StemResult measureFile(const std::string &path);
+    // The crop area of the image at path, already decoded; path names the debug images and error messages.
+    // With track the search is seeded from it like in measureTracked.
+    StemResult measureDecoded(const cv::Mat &pic, const std::string &path, StemTrack *track = nullptr);
+    // Next frame of a sequence, cropped like for measure. The wire and plant top are looked for only around the
+    // positions in track; the whole frame is searched when track is not valid or the tracked search fails.
+    // track is updated from the result.
+    StemResult measureTracked(const cv::Mat &pic, StemTrack &track);
+    // Every plant in pic, one per wire found in the top rows, left to right. Each plant gets the columns half way to
+    // the neighbouring wires; the plant tops and stems are searched in parallel, sharing the planes of the frame.
+    // A frame without a wire gives a single result with its status.
+    std::vector<StemResult> measurePlants(const cv::Mat &pic, const std::string &path = std::string());
+    // Stem width from a stalk mask ( CV_8UC1 of pic's size, above 127 on the stalk ) instead of the edges stemWidth
+    // detects: the wire and plant top are found as in measure, the stem sides are the mask transitions of each row
+    // and go through the same verification and width logic
+    StemResult measureWithMask(const cv::Mat &pic, const cv::Mat &mask);
+
+    // Scale of the frames measured from now on, StemParams::pixel_to_mm while it is not valid
+    void  setCalibration(const StemCalibration &calibration) { m_calibration = calibration; }
+    float pixelToMm() const { return m_calibration.valid() ? m_calibration.pixel_to_mm : m_params.pixel_to_mm; }
+
+    // Hough segment pairing, keeps near-vertical lines and pairs them with their closest neighbour, see SegmentPairer
+    void pairLines(std::vector<cv::Vec4i> &lines);
+    const std::vector<std::pair<cv::Vec4i, cv::Vec4i>> &pairedLines() const { return m_paired_lines; }
+    // Time spent in each stage of the wire edge and stem edge graphs, summed over every image measured so far
+    const StageTimes &stageTimes() const { return m_stage_times; }
+
+private:
+    friend struct StemStageBench; // bench/stage_bench.cpp times the stages one by one
+
+    struct WireTrace
+    {
+        int   row;      // first row with the wire
+        int   x;        // center in that row
+        float coverage; // part of the rows below it, up to hang_line_rows, where it continues
+    };
+    void  findWires(const cv::Mat1b &edges, std::vector<WireTrace> &wires);
+    void  findPlants(const cv::Mat &src, std::vector<StemResult> &plants);
+    const cv::Mat &prepareFrame(const cv::Mat &src, ImageContext &ctx);
+    void  measurePlant(ImageContext &ctx, const WireTrace &wire, int left, int right, StemResult &res);
+    int   findHangLine(const cv::Mat &src, StemResult &res);
+    int   findHangLineCoarse(const cv::Mat &src, StemResult &res);
+    int   findHangLineTracked(const cv::Mat &src, const StemTrack &track, StemResult &res);
+    const cv::Mat &wireEdges(ImageContext &ctx);
+    int   findWireRow(const cv::Mat &edges, std::vector<std::pair<int, int>> &line_starts, StemResult &res);
+    bool  stemWindow(int plant_top, cv::Size area, cv::Rect &selected_area, StemResult &res);
+    int   measureStem(ImageContext &ctx, int band_y, int start_row, cv::Rect selected_area, StemResult &res);
+    cv::Mat medianBand(const cv::Mat &src, const cv::Rect &r, WorkspaceSlot slot);
+    int   measureStemBand(const cv::Mat &src, int start_row, const cv::Rect &selected_area, StemResult &res);
+    int   greenRowInColumn(const cv::Mat &src, int x, int from, int to);
+    int   plantTopNear(const cv::Mat &src, int x, int start_row, int from, int to);
+    float stemWidth(ImageContext &area, int *support = nullptr);
+    float maskStemWidth(const cv::Mat &mask, int *support);
+    float stemWidthFromEdges(const cv::Mat1b &edges, int *support);
+    bool  verifyStems(std::pair<int, int> stem_sides, int row, const EdgeIndex &edges, const cv::Mat1b &edge_img,
+                      double &width_max, int &support);
+    void  trimToGreen(cv::Rect &r, const cv::Mat3b &pic_);
+
+    StemParams                                   m_params;
+    StemCalibration                              m_calibration;
+    StemWorkspace                                m_ws; // reused between measured images
+    bool                                         m_keep_equalization = false; // full search fills equalization_lut
+    std::vector<std::unique_ptr<StemMeasurer>>   m_plant_measurers; // stem scratch state of each plant
+    cv::Mat                                      m_stalk_mask; // set by measureWithMask, frame coordinates
+    SegmentPairer                                m_pairer;
+    StageGraph                                   m_graph; // redeclared by wireEdges and stemWidth on every call
+    StageTimes                                   m_stage_times;
+    std::vector<std::pair<cv::Vec4i, cv::Vec4i>> m_paired_lines;
+};
@@ -0,0 +1,80 @@
+#include "StemWorkspace.h"
+#include "StemMeasurer.h"
+
+#include <algorithm>
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace cv;
+
+static Mat ellipseElement(int morph_size) {
+    return getStructuringElement(MORPH_ELLIPSE,Size(2*morph_size+1,2*morph_size+1),Point(morph_size,morph_size));
+}
+static size_t bytesOf(const Mat &m) {
+    return m.total()*m.elemSize();
+}
+StemWorkspace::StemWorkspace(const StemParams &params) {
+    hang_line_close.setElement(ellipseElement(params.hang_line_morph));
+    stem_close.setElement(ellipseElement(params.stem_close_morph));
+    stem_erode.setElement(ellipseElement(params.stem_erode_morph));
+    stem_edge_close.setElement(getStructuringElement(MORPH_CROSS,Size(3,3),Point(1,1)));
+    // applied to H, S, equalized V
+    wire_rejection.below(2,params.wire_value).above(1,params.wire_saturation)
+                  .above(0,params.wire_hue_above).below(0,params.wire_hue_below);
+    stem_unsaturated.below(1,params.stem_saturation);
+}
+Mat &StemWorkspace::mat(WorkspaceSlot slot, Size size, int type) {
+    Slot &s(m_slots[slot]);
+    // the storage is a single row, every view is a continuous image of exactly size made from its start: blur,
+    // Canny and the morphology read around the edges of their input, which must give the border and not pixels
+    // a larger earlier image left there
+    const int n = size.area();
+    if(n==0) {
+        s.view = Mat(size,type);
+        return s.view;
+    }
+    if(s.storage.empty() || s.storage.type()!=type || !s.storage.isContinuous() || int(s.storage.total())<n) {
+        s.storage.create(1,n,type);
+        m_allocated += bytesOf(s.storage);
+    }
+    else if(s.storage.rows!=1)
+        s.storage = s.storage.reshape(0,1); // adopted from OpenCV in the shape of an image
+    s.view = s.storage.colRange(0,n).reshape(0,size.height);
+    // locateROI sizes the parent from dataend, ending it with the view makes the view a whole image
+    s.view.dataend = s.view.datastart+size_t(n)*s.view.elemSize();
+    return s.view;
+}
+std::vector<Mat> &StemWorkspace::planes(WorkspaceSlot first_slot, Size size, int depth, int count) {
+    std::vector<Mat> &v(m_planes[first_slot]);
+    v.resize(count);
+    for(int k=0; k<count; ++k)
+        v[k] = mat(WorkspaceSlot(first_slot+k),size,CV_MAKETYPE(depth,1));
+    return v;
+}
+void StemWorkspace::adopt(Slot &s, const Mat &current) {
+    // OpenCV replaced the handed out buffer, keep the new one so the next image can reuse it
+    m_allocated += bytesOf(current);
+    s.storage = current;
+}
+void StemWorkspace::beginImage() {
+    m_allocated = 0;
+}
+size_t StemWorkspace::endImage() {
+    for(int i=0; i<WS_SLOT_COUNT; ++i) {
+        Slot &s(m_slots[i]);
+        if(s.view.data && s.view.datastart!=s.storage.datastart)
+            adopt(s,s.view);
+        const std::vector<Mat> &v(m_planes[i]);
+        for(size_t k=0; k<v.size(); ++k) {
+            Slot &ps(m_slots[i+k]);
+            if(v[k].data && v[k].datastart!=ps.storage.datastart)
+                adopt(ps,v[k]);
+        }
+    }
+    return m_allocated;
+}
+size_t StemWorkspace::capacityBytes() const {
+    size_t total=0;
+    for(const Slot &s : m_slots)
+        total += bytesOf(s.storage);
+    return total;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "ColumnProfile.h"
+#include "EdgeIndex.h"
+#include "FastMorphology.h"
+#include "ImageContext.h"
+#include "RangeMask.h"
+
+struct StemParams;
+
+enum WorkspaceSlot
+{
+    // findHangLine
+    WS_MEDIAN = 0,
+    WS_WIRE_MASK,
+    WS_WIRE_MASK_CLOSED,
+    WS_EDGES_MASKED,
+    // ImageContext planes of the full frame
+    WS_HSV,
+    WS_HSV_PLANE0,
+    WS_HSV_PLANE1,
+    WS_HSV_PLANE2,
+    WS_HSV_180,
+    WS_V_EQUALIZED,
+    WS_HSV_EQUALIZED,
+    WS_RGB_EQUALIZED,
+    WS_GRAY,
+    WS_GRAY_BLURRED,
+    WS_EDGES,
+    WS_EQUALIZATION_LUT,
+    // ImageContext planes a roi() window computes for itself
+    WS_WINDOW_HSV,
+    WS_WINDOW_HSV_PLANE0,
+    WS_WINDOW_HSV_PLANE1,
+    WS_WINDOW_HSV_PLANE2,
+    WS_WINDOW_HSV_180,
+    WS_WINDOW_GRAY_BLURRED,
+    WS_WINDOW_EDGES,
+    // stemWidth
+    WS_STEM_FILTERED,
+    WS_STEM_CLOSED,
+    WS_STEM_SATURATION_MASK,
+    WS_STEM_FILTER,
+    WS_STEM_GRAY,
+    WS_STEM_GRAY_BLURRED,
+    WS_STEM_CANNY,
+    WS_STEM_EDGES,
+    // trimToGreen
+    WS_TRIM_BLURRED,
+    // coarse_scale search
+    WS_COARSE,
+    WS_COLUMN_MEDIAN,
+    // streamFramePlanes, one strip with its halo
+    WS_BAND_MEDIAN,
+    WS_BAND_BLURRED,
+
+    WS_SLOT_COUNT
+};
+
+// Scratch buffers of a single measurement worker. Every slot keeps the largest buffer requested so far and hands out
+// continuous images of the requested size made from it, so after the first few images the pipeline runs without
+// allocating its intermediates. A handed out image is not a ROI, filters see the border around it.
+class StemWorkspace
+{
+public:
+    explicit StemWorkspace(const StemParams &params);
+
+    // The returned header must be passed directly as the OpenCV output argument, so that a re-allocation done by
+    // OpenCV is noticed in endImage
+    cv::Mat &             mat(WorkspaceSlot slot, cv::Size size, int type);
+    std::vector<cv::Mat> &planes(WorkspaceSlot first_slot, cv::Size size, int depth, int count);
+
+    void   beginImage();
+    size_t endImage(); // bytes allocated since beginImage
+    size_t capacityBytes() const;
+
+    FastMorphology hang_line_close;
+    FastMorphology stem_close;
+    FastMorphology stem_erode;
+    FastMorphology stem_edge_close;
+    RangeMask      wire_rejection;   // pixels that can not belong to the hanging wire
+    RangeMask      stem_unsaturated; // pixels too gray to be the stem
+    EdgeIndex      stem_edge_index;
+    ColumnProfile  trim_profile;
+    ImageContext   coarse;           // reduced frame of the coarse_scale search
+    cv::Mat        equalization_lut; // V equalization of the reduced frame, applied to full resolution bands
+
+private:
+    struct Slot
+    {
+        cv::Mat storage;
+        cv::Mat view;
+    };
+    void adopt(Slot &s, const cv::Mat &current);
+
+    Slot                 m_slots[WS_SLOT_COUNT];
+    std::vector<cv::Mat> m_planes[WS_SLOT_COUNT]; // indexed by the first slot of the plane group
+    size_t               m_allocated = 0;
+};
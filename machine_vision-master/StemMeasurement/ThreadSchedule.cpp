@@ -0,0 +1,89 @@
+#include "ThreadSchedule.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <opencv2/core/core.hpp>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+const char *scheduleModeName(ScheduleMode mode) {
+    switch(mode) {
+        case SCHEDULE_AUTO: return "auto";
+        case SCHEDULE_INTER_IMAGE: return "inter";
+        case SCHEDULE_INTRA_IMAGE: return "intra";
+    }
+    return "unknown";
+}
+bool parseScheduleMode(const char *name, ScheduleMode &mode) {
+    for(ScheduleMode m : {SCHEDULE_AUTO,SCHEDULE_INTER_IMAGE,SCHEDULE_INTRA_IMAGE}) {
+        if(0==strcmp(name,scheduleModeName(m))) {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+int availableCores() {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    if(0==sched_getaffinity(0,sizeof(allowed),&allowed))
+        return std::max(1,CPU_COUNT(&allowed));
+#endif
+    return std::max(1u,std::thread::hardware_concurrency());
+}
+bool pinCurrentThread(int index) {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    if(0!=sched_getaffinity(0,sizeof(allowed),&allowed) || CPU_COUNT(&allowed)==0)
+        return false;
+    int wanted = index%CPU_COUNT(&allowed);
+    for(int cpu=0; cpu<CPU_SETSIZE; ++cpu) {
+        if(!CPU_ISSET(cpu,&allowed) || wanted-->0)
+            continue;
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(cpu,&one);
+        return 0==pthread_setaffinity_np(pthread_self(),sizeof(one),&one);
+    }
+#else
+    (void)index;
+#endif
+    return false;
+}
+SchedulePlan planSchedule(ScheduleMode mode, size_t queued_images, int cores, int workers) {
+    SchedulePlan plan;
+    plan.cores = cores>0 ? cores : availableCores();
+    plan.queued_images = queued_images;
+    const int images = int(std::min<size_t>(std::max<size_t>(queued_images,1),plan.cores));
+    if(mode==SCHEDULE_AUTO) {
+        // a worker per queued image up to one per core, the cores left over go to OpenCV
+        plan.mode = images>=plan.cores ? SCHEDULE_INTER_IMAGE : SCHEDULE_INTRA_IMAGE;
+        plan.workers = images;
+    }
+    else {
+        plan.mode = mode;
+        plan.workers = mode==SCHEDULE_INTER_IMAGE ? images : 1;
+    }
+    if(workers>0) {
+        // the OpenCV threads and decoders below are sized for the requested workers
+        plan.workers = int(std::min<size_t>(workers,std::max<size_t>(queued_images,1)));
+        if(mode==SCHEDULE_AUTO)
+            plan.mode = plan.workers>=plan.cores ? SCHEDULE_INTER_IMAGE : SCHEDULE_INTRA_IMAGE;
+    }
+    plan.opencv_threads = plan.mode==SCHEDULE_INTER_IMAGE ? 1 : std::max(1,plan.cores/plan.workers);
+    // decoding the crop is cheaper than measuring it, decoders sleep while the measuring queue is full
+    plan.decoders = std::max(1,std::min(plan.workers,plan.cores/4));
+    return plan;
+}
+void applySchedule(const SchedulePlan &plan) {
+    cv::setNumThreads(plan.opencv_threads);
+}
+void printSchedule(FILE *out, const SchedulePlan &plan) {
+    fprintf(out,"schedule %s: %d cores, %zu queued images, %d workers%s, %d decoders, %d OpenCV threads\n",
+            scheduleModeName(plan.mode),plan.cores,plan.queued_images,plan.workers,
+            plan.pin_workers ? " pinned" : "",plan.decoders,plan.opencv_threads);
+}
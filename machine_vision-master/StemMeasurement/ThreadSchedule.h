@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+
+enum ScheduleMode
+{
+    SCHEDULE_AUTO = 0,
+    SCHEDULE_INTER_IMAGE, // one image per worker, OpenCV single threaded
+    SCHEDULE_INTRA_IMAGE, // fewer workers than cores, the rest run OpenCV's parallel loops inside each image
+};
+const char *scheduleModeName(ScheduleMode mode);
+bool        parseScheduleMode(const char *name, ScheduleMode &mode);
+
+struct SchedulePlan
+{
+    ScheduleMode mode           = SCHEDULE_INTER_IMAGE; // never SCHEDULE_AUTO
+    int          cores          = 1;
+    size_t       queued_images  = 0;
+    int          workers        = 1;
+    int          decoders       = 1;
+    int          opencv_threads = 1;
+    bool         pin_workers    = false;
+};
+
+// AUTO picks inter-image parallelism when at least as many images are queued as there are cores, and otherwise
+// gives every queued image a worker and spreads the cores over their OpenCV calls. INTER_IMAGE and INTRA_IMAGE force
+// a worker per core or a single worker using all cores. cores 0 means the CPUs this process may run on. workers above
+// 0 replaces the planned worker count, up to one per queued image, and the OpenCV threads are divided among them.
+SchedulePlan planSchedule(ScheduleMode mode, size_t queued_images, int cores = 0, int workers = 0);
+// Sets the OpenCV thread count of the plan, process wide
+void applySchedule(const SchedulePlan &plan);
+void printSchedule(FILE *out, const SchedulePlan &plan);
+
+int  availableCores();
+// Pins the calling thread to the index-th CPU it is allowed to run on ( modulo their count ), false where
+// affinity is not supported
+bool pinCurrentThread(int index);
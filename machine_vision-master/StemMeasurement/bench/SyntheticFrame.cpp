@@ -0,0 +1,62 @@
+#include "SyntheticFrame.h"
+
+#include <algorithm>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "EdgeRuns.h"
+
+using namespace std;
+using namespace cv;
+
+SyntheticFrameSpec scaledFrameSpec(double scale) {
+    SyntheticFrameSpec spec;
+    spec.size = Size(cvRound(spec.size.width*scale),cvRound(spec.size.height*scale));
+    spec.wire_x = spec.size.width/2;
+    // the wire and the stem stay as wide as the run scanners accept, with a few pixels for where Canny puts their
+    // edges; outside of that the pipeline would only take its early exits
+    const int margin = 3;
+    spec.wire_width = std::min(std::max(cvRound(spec.wire_width*scale),WireRunScanner::min_width+margin),
+                               WireRunScanner::max_width-margin);
+    spec.plant_top = cvRound(spec.plant_top*scale);
+    spec.stem_width = std::min(std::max(cvRound(spec.stem_width*scale),StemRunScanner::min_width+margin),
+                               StemRunScanner::max_width-margin);
+    return spec;
+}
+Mat syntheticPlantFrame(const SyntheticFrameSpec &spec) {
+    RNG rng(spec.seed);
+    const double scale = spec.size.width/900.0;
+    Mat frame(spec.size,CV_8UC3,Scalar(40,50,60));
+    // the wire ends in the canopy, the stem starts under its middle
+    line(frame,Point(spec.wire_x,0),Point(spec.wire_x,spec.plant_top+cvRound(40*scale)),Scalar(235,235,235),
+         spec.wire_width);
+    Size canopy(cvRound(220*scale),cvRound(150*scale));
+    Point canopy_center(spec.wire_x,spec.plant_top+canopy.height);
+    ellipse(frame,canopy_center,canopy,0,0,360,Scalar(40,170,60),-1);
+    const int stem_left = spec.wire_x-spec.stem_width/2;
+    const int stem_top = canopy_center.y;
+    // leaves alternate sides below the canopy, each starting at the stem
+    const int leaf_span = spec.size.height-stem_top;
+    for(int i=0; i<spec.leaves && leaf_span>0; ++i) {
+        Size leaf(cvRound(rng.uniform(70.0,150.0)*scale),cvRound(rng.uniform(20.0,36.0)*scale));
+        int y = stem_top+int((i+rng.uniform(0.2,0.8))*leaf_span/spec.leaves);
+        bool right = (i&1)!=0;
+        double angle = right ? rng.uniform(-35.0,-10.0) : rng.uniform(10.0,35.0);
+        Point center(right ? stem_left+spec.stem_width+leaf.width*7/8 : stem_left-leaf.width*7/8,y);
+        int reach = leaf.width/2+leaf.height;
+        if(spec.leaf_free_rows.height>0 && y+reach>spec.leaf_free_rows.y &&
+           y-reach<spec.leaf_free_rows.y+spec.leaf_free_rows.height)
+            continue;
+        ellipse(frame,center,leaf,angle,0,360,Scalar(60,180,50),-1);
+    }
+    rectangle(frame,Point(stem_left,stem_top),Point(stem_left+spec.stem_width-1,spec.size.height-1),
+              Scalar(50,150,70),-1);
+    if(spec.noise>0) {
+        Mat noise(spec.size,CV_16SC3), sum;
+        rng.fill(noise,RNG::NORMAL,0,spec.noise);
+        frame.convertTo(sum,CV_16SC3);
+        sum += noise;
+        sum.convertTo(frame,CV_8UC3);
+    }
+    return frame;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+// Layout of a generated plant crop area: a white wire from the top down to the plant, a green canopy at the plant
+// top, a green stem of known width hanging from it to the bottom, leaves along the stem and gaussian noise.
+struct SyntheticFrameSpec
+{
+    cv::Size size           = cv::Size(900, 3700); // the default StemParams::crop_area
+    int      wire_x         = 450;
+    int      wire_width     = 8;
+    int      plant_top      = 600;                 // first canopy row, where the wire ends
+    int      stem_width     = 30;                  // exact width of the drawn stem, in pixels
+    int      leaves         = 8;
+    cv::Rect leaf_free_rows = cv::Rect();          // no leaf overlaps these rows ( only y and height are used )
+    double   noise          = 6;                   // standard deviation added to every channel
+    uint64_t seed           = 1;
+};
+
+// The default layout with every length scaled, for frames at a fraction of the camera resolution. The wire and stem
+// widths are kept within the widths WireRunScanner and StemRunScanner accept.
+SyntheticFrameSpec scaledFrameSpec(double scale);
+// Deterministic for a given spec, CV_8UC3
+cv::Mat syntheticPlantFrame(const SyntheticFrameSpec &spec);
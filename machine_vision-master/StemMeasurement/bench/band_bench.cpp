@@ -0,0 +1,75 @@
+#include <benchmark/benchmark.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "BandStream.h"
+#include "ImageContext.h"
+#include "StemMeasurer.h"
+#include "StemWorkspace.h"
+#include "SyntheticFrame.h"
+
+using namespace std;
+using namespace cv;
+
+static const Mat &benchFrame() {
+    static Mat frame;
+    if(frame.empty())
+        frame = syntheticPlantFrame(SyntheticFrameSpec());
+    return frame;
+}
+// The planes findHangLine reads before Canny, with one whole image call per step
+static void wholeFramePlanes(const Mat &src,StemWorkspace &ws,ImageContext &ctx) {
+    Mat &pic = ws.mat(WS_MEDIAN,src.size(),src.type());
+    medianBlur(src,pic,3);
+    ctx.reset(pic);
+    ctx.hsvFull();
+    ctx.blurredGray();
+}
+// Planes of the two contexts that differ in any pixel, the edges included
+static int differingPlanes(ImageContext &a,ImageContext &b,int canny_param) {
+    const Mat planes_a[] = {a.base(),a.hsvFull(),a.hsvPlane(0),a.hsvPlane(1),a.hsvPlane(2),a.equalizedV(),
+                            a.equalizedHsv(),a.equalizedRgb(),a.equalizedGray(),a.blurredGray(),a.edges(canny_param)};
+    const Mat planes_b[] = {b.base(),b.hsvFull(),b.hsvPlane(0),b.hsvPlane(1),b.hsvPlane(2),b.equalizedV(),
+                            b.equalizedHsv(),b.equalizedRgb(),b.equalizedGray(),b.blurredGray(),b.edges(canny_param)};
+    int differing = 0;
+    for(size_t i=0; i<sizeof(planes_a)/sizeof(planes_a[0]); ++i)
+        differing += planes_a[i].size()!=planes_b[i].size() || norm(planes_a[i],planes_b[i],NORM_INF)!=0;
+    return differing;
+}
+static void BM_PlanesWhole(benchmark::State &state) {
+    const Mat &frame(benchFrame());
+    StemParams params;
+    StemWorkspace ws(params);
+    ImageContext ctx(Mat(),&ws);
+    for(auto _ : state) {
+        wholeFramePlanes(frame,ws,ctx);
+        benchmark::DoNotOptimize(ctx.blurredGray().data);
+    }
+    state.counters["s/pixel"] = benchmark::Counter(frame.total(),benchmark::Counter::kIsIterationInvariantRate |
+                                                                     benchmark::Counter::kInvert);
+}
+// arg: rows per strip
+static void BM_PlanesBanded(benchmark::State &state) {
+    const Mat &frame(benchFrame());
+    StemParams params;
+    StemWorkspace ws(params), reference_ws(params);
+    ImageContext ctx(Mat(),&ws), reference(Mat(),&reference_ws);
+    wholeFramePlanes(frame,reference_ws,reference);
+    streamFramePlanes(frame,ws,ctx,state.range(0));
+    if(int differing = differingPlanes(ctx,reference,params.canny_hang_line)) {
+        state.SkipWithError(differing==1 ? "a streamed plane differs from the whole image one"
+                                         : "streamed planes differ from the whole image ones");
+        return;
+    }
+    for(auto _ : state) {
+        streamFramePlanes(frame,ws,ctx,state.range(0));
+        benchmark::DoNotOptimize(ctx.blurredGray().data);
+    }
+    state.counters["s/pixel"] = benchmark::Counter(frame.total(),benchmark::Counter::kIsIterationInvariantRate |
+                                                                     benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_PlanesWhole)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_PlanesBanded)->Arg(1)->Arg(32)->Arg(64)->Arg(96)->Arg(128)->Arg(256)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,40 @@
+#include <cmath>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "Calibration.h"
+
+using namespace std;
+using namespace cv;
+
+// Corners of a square with sides of side pixels turned by degrees around centre, in order around it like the QR code
+// detector gives them
+static vector<Point2f> squareCorners(Point2f centre, float side, double degrees) {
+    const double a = degrees*CV_PI/180;
+    const Point2f u(float(std::cos(a)*side/2),float(std::sin(a)*side/2));
+    const Point2f v(-u.y,u.x);
+    return {centre-u-v,centre+u-v,centre+u+v,centre-u+v};
+}
+// args: side of the marker in pixels, rotation in degrees
+static void BM_MarkerCalibration(benchmark::State &state) {
+    const float marker_mm = StemParams().marker_mm;
+    const float side = float(state.range(0));
+    vector<Point2f> corners = squareCorners(Point2f(1234.5f,987.25f),side,double(state.range(1)));
+    const float expected = marker_mm/side;
+    StemCalibration res = markerCalibration(corners,marker_mm);
+    if(!res.valid() || std::fabs(res.pixel_to_mm-expected)>expected*1e-4f) {
+        state.SkipWithError("the scale of the marker is not recovered");
+        return;
+    }
+    for(auto _ : state) {
+        res = markerCalibration(corners,marker_mm);
+        benchmark::DoNotOptimize(res.pixel_to_mm);
+    }
+    state.counters["pixel_to_mm"] = res.pixel_to_mm;
+}
+BENCHMARK(BM_MarkerCalibration)->Args({150,0})->Args({150,30})->Args({75,45})->Args({400,-12});
+
+BENCHMARK_MAIN();
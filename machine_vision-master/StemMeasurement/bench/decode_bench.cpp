@@ -0,0 +1,112 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "ImageLoader.h"
+#include "StemMeasurer.h"
+
+using namespace std;
+using namespace cv;
+
+// Exif APP1 segment holding only the Orientation tag, little endian
+static vector<uchar> exifOrientationSegment(int orientation) {
+    const uchar exif[] = {0xFF,0xE1,0,32,'E','x','i','f',0,0,'I','I',42,0,8,0,0,0,
+                          1,0,0x12,0x01,3,0,1,0,0,0,uchar(orientation),0,0,0,0,0,0,0};
+    return vector<uchar>(exif,exif+sizeof(exif));
+}
+// The frame named by STEM_BENCH_FRAME, or a synthetic JPEG of the given size written to the temp directory. With an
+// orientation other than 1 the file is stored rotated by the Exif tag like a camera held upright does, cv::imread
+// turns it back to cols x rows.
+static string benchFile(int cols, int rows, int orientation = 1) {
+    const char *path = getenv("STEM_BENCH_FRAME");
+    if(path)
+        return path;
+    char name[64];
+    snprintf(name,sizeof(name),"stem_decode_bench_%dx%d_o%d.jpg",cols,rows,orientation);
+    const char *tmp = getenv("TMPDIR");
+    string file = string(tmp ? tmp : "/tmp")+"/"+name;
+    FILE *f = fopen(file.c_str(),"rb");
+    if(f) {
+        fclose(f);
+        return file;
+    }
+    // orientations 5 to 8 store the frame transposed
+    if(orientation>=5)
+        std::swap(cols,rows);
+    // smooth content with some noise compresses about like a camera frame
+    Mat small(rows/16,cols/16,CV_8UC3),frame,noise(rows,cols,CV_8UC3);
+    randu(small,Scalar::all(0),Scalar::all(256));
+    resize(small,frame,Size(cols,rows),0,0,INTER_CUBIC);
+    randu(noise,Scalar::all(0),Scalar::all(24));
+    frame += noise;
+    vector<int> quality;
+    quality.push_back(CV_IMWRITE_JPEG_QUALITY);
+    quality.push_back(92);
+    vector<uchar> jpeg;
+    imencode(".jpg",frame,jpeg,quality);
+    if(orientation!=1) {
+        vector<uchar> exif = exifOrientationSegment(orientation);
+        jpeg.insert(jpeg.begin()+2,exif.begin(),exif.end()); // right after SOI
+    }
+    f = fopen(file.c_str(),"wb");
+    if(f) {
+        fwrite(&jpeg[0],1,jpeg.size(),f);
+        fclose(f);
+    }
+    return file;
+}
+// args: frame cols, rows, Exif orientation
+static void BM_DecodeFull(benchmark::State &state) {
+    string file = benchFile(state.range(0),state.range(1),state.range(2));
+    Rect crop = StemParams().crop_area;
+    for(auto _ : state) {
+        Mat frame = imread(file);
+        Mat pic = frame(crop & Rect(0,0,frame.cols,frame.rows));
+        benchmark::DoNotOptimize(pic.data);
+    }
+}
+static void BM_DecodeRoi(benchmark::State &state) {
+    string file = benchFile(state.range(0),state.range(1),state.range(2));
+    Rect crop = StemParams().crop_area;
+    bool partial = false;
+    Mat pic = loadImageRoi(file,crop,&partial);
+    Mat frame = imread(file);
+    Mat expected = frame(crop & Rect(0,0,frame.cols,frame.rows));
+    if(pic.size()!=expected.size()) {
+        state.SkipWithError("roi size differs from the cropped full decode");
+        return;
+    }
+    // a different libjpeg build inside OpenCV may round the IDCT differently
+    double max_diff = norm(pic,expected,NORM_INF);
+    if(max_diff>2) {
+        state.SkipWithError("roi pixels differ from the cropped full decode");
+        return;
+    }
+    state.SetLabel(partial ? "partial decode" : "full decode fallback");
+    for(auto _ : state) {
+        pic = loadImageRoi(file,crop);
+        benchmark::DoNotOptimize(pic.data);
+    }
+    state.counters["max_diff"] = max_diff;
+}
+static void frameSizes(benchmark::internal::Benchmark *b) {
+    // smallest frame holding the crop area, two larger portrait frames, and one stored landscape with the camera's
+    // Orientation=6 which the partial decoder must leave to cv::imread
+    StemParams params;
+    b->Args({params.crop_area.x+params.crop_area.width,params.crop_area.y+params.crop_area.height,1});
+    b->Args({3000,4500,1});
+    b->Args({3456,4608,1});
+    b->Args({3000,4500,6});
+}
+BENCHMARK(BM_DecodeFull)->Apply(frameSizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DecodeRoi)->Apply(frameSizes)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,101 @@
+#include <benchmark/benchmark.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "EdgeRuns.h"
+#include "StemMeasurer.h"
+
+using namespace std;
+using namespace cv;
+
+// Per-pixel Mat_ access, as findPossibleStemStarts did it before the scanner
+static vector<pair<int,int> > legacyStemStarts(const Mat1b &edges,int row) {
+    vector<pair<int,int> > possible_starts;
+    for(int i=0; i<edges.cols; ++i) {
+        if(0==edges.row(row)(i))
+            continue;
+        int line_end=i+1;
+        for(; line_end<edges.cols; ++line_end) {
+            if((edges.row(row)(line_end)!=0) || ((line_end-i) > 100))
+                break;
+        }
+        if(line_end==edges.cols)
+            break;
+        if(line_end-i < 5) {
+            i = line_end-1;
+            continue;
+        }
+        if(((line_end-i) > 25) &&  ((line_end-i) < 90)) {
+            possible_starts.push_back(make_pair(i,line_end));
+            i = line_end;
+            continue;
+        }
+        i = line_end-1;
+    }
+    return possible_starts;
+}
+static int legacyEdgeRight(Point start_at,const Mat1b &edges,int maxX) {
+    for(int x=start_at.x; (x<edges.cols) && (x<maxX); ++x) {
+        if(edges(Point(x,start_at.y)))
+            return x;
+    }
+    return edges.cols;
+}
+// Canny-like edge rows sized like the stem search window: a few stem/leaf edge pairs and sparse noise
+static Mat1b edgeWindow(int density) {
+    StemParams params;
+    Mat1b edges(params.stem_window_rows,params.crop_area.width,uchar(0));
+    RNG rng(7);
+    for(int y=0; y<edges.rows; ++y) {
+        for(int k=0; k<density; ++k)
+            edges(y,rng.uniform(0,edges.cols)) = 255;
+        int stem = 300+rng.uniform(0,200);
+        edges(y,stem) = 255;
+        edges(y,stem+40+rng.uniform(0,4)) = 255;
+    }
+    return edges;
+}
+static void BM_StemStartsLegacy(benchmark::State &state) {
+    Mat1b edges = edgeWindow(state.range(0));
+    for(auto _ : state) {
+        for(int y=edges.rows-1; y>45; --y)
+            benchmark::DoNotOptimize(legacyStemStarts(edges,y).size());
+    }
+    state.SetItemsProcessed(state.iterations()*(edges.rows-46)*edges.cols);
+}
+static void BM_StemStartsScanner(benchmark::State &state) {
+    Mat1b edges = edgeWindow(state.range(0));
+    for(int y=edges.rows-1; y>45; --y) {
+        if(legacyStemStarts(edges,y)!=StemRunScanner::scanRow(edges,y)) {
+            state.SkipWithError("scanner runs differ from the per-pixel scan");
+            return;
+        }
+    }
+    vector<EdgeRun> runs;
+    for(auto _ : state) {
+        runs.clear();
+        StemRunScanner::scanRows(edges,edges.rows-1,46,runs);
+        benchmark::DoNotOptimize(runs.data());
+    }
+    state.SetItemsProcessed(state.iterations()*(edges.rows-46)*edges.cols);
+}
+static void BM_NextEdgeRightLegacy(benchmark::State &state) {
+    Mat1b edges = edgeWindow(state.range(0));
+    for(auto _ : state) {
+        for(int y=0; y<edges.rows; ++y)
+            benchmark::DoNotOptimize(legacyEdgeRight(Point(0,y),edges,edges.cols));
+    }
+}
+static void BM_NextEdgeRightScanner(benchmark::State &state) {
+    Mat1b edges = edgeWindow(state.range(0));
+    for(auto _ : state) {
+        for(int y=0; y<edges.rows; ++y)
+            benchmark::DoNotOptimize(nextNonZero(edges.ptr<uchar>(y),0,edges.cols));
+    }
+}
+BENCHMARK(BM_StemStartsLegacy)->Arg(0)->Arg(8)->Arg(64)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_StemStartsScanner)->Arg(0)->Arg(8)->Arg(64)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_NextEdgeRightLegacy)->Arg(0)->Arg(8)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_NextEdgeRightScanner)->Arg(0)->Arg(8)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
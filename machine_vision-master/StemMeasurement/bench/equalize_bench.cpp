@@ -0,0 +1,108 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "FusedEqualize.h"
+#include "ImageContext.h"
+#include "SyntheticFrame.h"
+
+using namespace std;
+using namespace cv;
+
+// arg 0 is the median of a synthetic plant frame, arg 1 random pixels so every hue and saturation occurs
+static const Mat &benchFrame(int kind) {
+    static Mat frames[2];
+    Mat &frame = frames[kind];
+    if(frame.empty()) {
+        const Mat plant = syntheticPlantFrame(SyntheticFrameSpec());
+        if(kind==0)
+            medianBlur(plant,frame,3);
+        else {
+            frame.create(plant.size(),CV_8UC3);
+            randu(frame,Scalar::all(0),Scalar::all(256));
+        }
+    }
+    return frame;
+}
+struct EqualizedPlanes
+{
+    Mat hsv, rgb, gray;
+};
+// The steps ImageContext took before equalizeRgb, one whole image call each
+static void separateEqualize(const Mat &rgb, vector<Mat> &channels, Mat &hsv_full, EqualizedPlanes &out) {
+    cvtColor(rgb,hsv_full,CV_RGB2HSV_FULL);
+    split(hsv_full,channels);
+    equalizeHist(channels[2],channels[2]);
+    merge(channels,out.hsv);
+    cvtColor(out.hsv,out.rgb,CV_HSV2RGB_FULL);
+    cvtColor(out.rgb,out.gray,CV_RGB2GRAY);
+}
+static void fusedEqualize(const Mat &rgb, Mat &lut, EqualizedPlanes &out) {
+    int hist[256] = {0};
+    valueHistogram(rgb,hist);
+    equalizationLut(hist,int(rgb.total()),lut);
+    equalizeRgb(rgb,lut,out.rgb,out.gray,&out.hsv);
+}
+// Pixels of a and b that differ in any channel, and the largest difference of a channel
+static int differingPixels(const Mat &a, const Mat &b, int &max_diff) {
+    Mat diff;
+    absdiff(a,b,diff);
+    const int cn = diff.channels();
+    int differing = 0;
+    for(int y=0; y<diff.rows; ++y) {
+        const uchar *d = diff.ptr<uchar>(y);
+        for(int x=0; x<diff.cols; ++x, d+=cn) {
+            int m = 0;
+            for(int c=0; c<cn; ++c)
+                m = std::max(m,int(d[c]));
+            differing += m>0;
+            max_diff = std::max(max_diff,m);
+        }
+    }
+    return differing;
+}
+static void perPixel(benchmark::State &state, size_t pixels) {
+    state.counters["s/pixel"] = benchmark::Counter(pixels,benchmark::Counter::kIsIterationInvariantRate |
+                                                              benchmark::Counter::kInvert);
+}
+static void BM_EqualizeSeparate(benchmark::State &state) {
+    const Mat &frame(benchFrame(state.range(0)));
+    vector<Mat> channels;
+    Mat hsv_full;
+    EqualizedPlanes out;
+    for(auto _ : state) {
+        separateEqualize(frame,channels,hsv_full,out);
+        benchmark::DoNotOptimize(out.gray.data);
+    }
+    perPixel(state,frame.total());
+}
+static void BM_EqualizeFused(benchmark::State &state) {
+    const Mat &frame(benchFrame(state.range(0)));
+    vector<Mat> channels;
+    Mat hsv_full, lut;
+    EqualizedPlanes reference, out;
+    separateEqualize(frame,channels,hsv_full,reference);
+    fusedEqualize(frame,lut,out);
+    int max_diff = 0;
+    const int differing = differingPixels(out.hsv,reference.hsv,max_diff)+
+                          differingPixels(out.rgb,reference.rgb,max_diff)+
+                          differingPixels(out.gray,reference.gray,max_diff);
+    if(differing) {
+        char msg[128];
+        snprintf(msg,sizeof(msg),"%d pixels differ from the separate steps, by up to %d",differing,max_diff);
+        state.SkipWithError(msg);
+        return;
+    }
+    for(auto _ : state) {
+        fusedEqualize(frame,lut,out);
+        benchmark::DoNotOptimize(out.gray.data);
+    }
+    perPixel(state,frame.total());
+}
+BENCHMARK(BM_EqualizeSeparate)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EqualizeFused)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
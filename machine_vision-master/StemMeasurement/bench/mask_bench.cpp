@@ -0,0 +1,122 @@
+#include <benchmark/benchmark.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "RangeMask.h"
+#include "StemMeasurer.h"
+
+using namespace std;
+using namespace cv;
+
+// HSV_FULL sized like the default crop area, random content so no branch or rule is favoured
+static const Mat &hsvFrame() {
+    static Mat frame;
+    if(frame.empty()) {
+        StemParams params;
+        frame.create(params.crop_area.size(),CV_8UC3);
+        randu(frame,Scalar::all(0),Scalar::all(256));
+    }
+    return frame;
+}
+static RangeMask wireRule(const StemParams &p) {
+    RangeMask rule;
+    rule.below(2,p.wire_value).above(1,p.wire_saturation).above(0,p.wire_hue_above).below(0,p.wire_hue_below);
+    return rule;
+}
+static Mat wireMaskExpression(const Mat &hsv, const StemParams &p) {
+    // the original form: split, then one temporary per comparison and per OR
+    vector<Mat> planes;
+    split(hsv,planes);
+    return (planes[2]<p.wire_value) | (planes[1]>p.wire_saturation) | (planes[0]>p.wire_hue_above) |
+           (planes[0]<p.wire_hue_below);
+}
+static void BM_WireMaskExpression(benchmark::State &state) {
+    StemParams params;
+    const Mat &hsv(hsvFrame());
+    for(auto _ : state)
+        benchmark::DoNotOptimize(wireMaskExpression(hsv,params).data);
+    state.SetItemsProcessed(state.iterations()*hsv.total());
+}
+static void BM_WireMaskCompareChain(benchmark::State &state) {
+    StemParams params;
+    const Mat &hsv(hsvFrame());
+    vector<Mat> planes;
+    Mat res,tmp;
+    for(auto _ : state) {
+        // compare/bitwise_or into reused buffers, still one pass per comparison
+        split(hsv,planes);
+        compare(planes[2],params.wire_value,res,CMP_LT);
+        compare(planes[1],params.wire_saturation,tmp,CMP_GT);
+        bitwise_or(res,tmp,res);
+        compare(planes[0],params.wire_hue_above,tmp,CMP_GT);
+        bitwise_or(res,tmp,res);
+        compare(planes[0],params.wire_hue_below,tmp,CMP_LT);
+        bitwise_or(res,tmp,res);
+        benchmark::DoNotOptimize(res.data);
+    }
+    state.SetItemsProcessed(state.iterations()*hsv.total());
+}
+static void BM_WireMaskFused(benchmark::State &state) {
+    StemParams params;
+    const Mat &hsv(hsvFrame());
+    RangeMask rule = wireRule(params);
+    Mat res;
+    rule.apply(hsv,res);
+    if(countNonZero(res!=wireMaskExpression(hsv,params))!=0) {
+        state.SkipWithError("fused mask differs from the OpenCV expression");
+        return;
+    }
+    for(auto _ : state) {
+        rule.apply(hsv,res);
+        benchmark::DoNotOptimize(res.data);
+    }
+    state.SetItemsProcessed(state.iterations()*hsv.total());
+    state.SetLabel(RangeMask::implementation());
+}
+static void BM_WireMaskFusedRoi(benchmark::State &state) {
+    // non continuous input, as used by stemWidth on its search area
+    StemParams params;
+    const Mat hsv = hsvFrame()(Rect(7,0,hsvFrame().cols-14,hsvFrame().rows));
+    RangeMask rule = wireRule(params);
+    Mat res;
+    for(auto _ : state) {
+        rule.apply(hsv,res);
+        benchmark::DoNotOptimize(res.data);
+    }
+    state.SetItemsProcessed(state.iterations()*hsv.total());
+    state.SetLabel(RangeMask::implementation());
+}
+static void BM_SaturationMaskCompare(benchmark::State &state) {
+    StemParams params;
+    const Mat &hsv(hsvFrame());
+    vector<Mat> planes;
+    Mat res;
+    for(auto _ : state) {
+        split(hsv,planes);
+        compare(planes[1],params.stem_saturation,res,CMP_LT);
+        benchmark::DoNotOptimize(res.data);
+    }
+    state.SetItemsProcessed(state.iterations()*hsv.total());
+}
+static void BM_SaturationMaskFused(benchmark::State &state) {
+    StemParams params;
+    const Mat &hsv(hsvFrame());
+    RangeMask rule;
+    rule.below(1,params.stem_saturation);
+    Mat res;
+    for(auto _ : state) {
+        rule.apply(hsv,res);
+        benchmark::DoNotOptimize(res.data);
+    }
+    state.SetItemsProcessed(state.iterations()*hsv.total());
+    state.SetLabel(RangeMask::implementation());
+}
+BENCHMARK(BM_WireMaskExpression)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_WireMaskCompareChain)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_WireMaskFused)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_WireMaskFusedRoi)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SaturationMaskCompare)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SaturationMaskFused)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
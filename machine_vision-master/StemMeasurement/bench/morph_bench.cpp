@@ -0,0 +1,92 @@
+#include <cstdlib>
+
+#include <benchmark/benchmark.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "FastMorphology.h"
+#include "StemMeasurer.h"
+
+using namespace std;
+using namespace cv;
+
+// Crop of the frame named by STEM_BENCH_FRAME, random content when it is not set
+static const Mat &benchFrame() {
+    static Mat frame;
+    if(frame.empty()) {
+        StemParams params;
+        const char *path = getenv("STEM_BENCH_FRAME");
+        Mat loaded = path ? imread(path) : Mat();
+        Rect crop = params.crop_area & Rect(0,0,loaded.cols,loaded.rows);
+        if(crop.area()>0)
+            frame = loaded(crop).clone();
+        else {
+            frame.create(params.crop_area.size(),CV_8UC3);
+            randu(frame,Scalar::all(0),Scalar::all(256));
+            medianBlur(frame,frame,5);
+        }
+    }
+    return frame;
+}
+// rows rows from the middle of the frame, or of its thresholded gray image, without the outer columns. Such a ROI
+// reads the image around it under the element, like the stemWidth window does. The whole image for all rows.
+static Mat benchInput(bool color, int rows) {
+    static Mat binary;
+    if(binary.empty()) {
+        Mat gray;
+        cvtColor(benchFrame(),gray,CV_RGB2GRAY);
+        binary = gray>128;
+    }
+    const Mat &img(color ? benchFrame() : binary);
+    if(rows>=img.rows)
+        return img;
+    return img(Rect(img.cols/8,(img.rows-rows)/2,img.cols-img.cols/4,rows));
+}
+static Mat ellipseElement(int morph_size) {
+    return getStructuringElement(MORPH_ELLIPSE,Size(2*morph_size+1,2*morph_size+1),Point(morph_size,morph_size));
+}
+// args: morph size, color, rows
+static void BM_MorphOpenCV(benchmark::State &state) {
+    Mat src = benchInput(state.range(1)!=0,state.range(2));
+    Mat element = ellipseElement(state.range(0));
+    Mat dst;
+    for(auto _ : state) {
+        morphologyEx(src,dst,MORPH_CLOSE,element);
+        benchmark::DoNotOptimize(dst.data);
+    }
+    state.SetItemsProcessed(state.iterations()*src.total());
+}
+static void BM_MorphFast(benchmark::State &state) {
+    Mat src = benchInput(state.range(1)!=0,state.range(2));
+    Mat element = ellipseElement(state.range(0));
+    FastMorphology morph(element);
+    Mat dst,expected;
+    morph.apply(src,dst,MORPH_CLOSE);
+    morphologyEx(src,expected,MORPH_CLOSE,element);
+    Mat differs;
+    compare(dst,expected,differs,CMP_NE);
+    if(countNonZero(differs.reshape(1))!=0) {
+        state.SkipWithError("result differs from morphologyEx");
+        return;
+    }
+    for(auto _ : state) {
+        morph.apply(src,dst,MORPH_CLOSE);
+        benchmark::DoNotOptimize(dst.data);
+    }
+    state.SetItemsProcessed(state.iterations()*src.total());
+}
+static void morphArgs(benchmark::internal::Benchmark *b) {
+    StemParams params;
+    // stemWidth close on its window, stemWidth erode, findHangLine close on the whole crop
+    b->Args({params.stem_close_morph,1,params.stem_window_rows});
+    b->Args({params.stem_erode_morph,0,params.stem_window_rows});
+    b->Args({params.hang_line_morph,0,params.crop_area.height});
+    for(int size : {3,7,15,21})
+        b->Args({size,1,params.crop_area.height});
+}
+BENCHMARK(BM_MorphOpenCV)->Apply(morphArgs)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_MorphFast)->Apply(morphArgs)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,165 @@
+#include <cmath>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "SegmentPairing.h"
+
+using namespace std;
+using namespace cv;
+
+typedef vector<std::pair<Vec4i,Vec4i> > Pairs;
+
+// The angle buckets and quadratic scans StemMeasurer::pairLines used before SegmentPairer, erasing paired segments
+static float legacyDistanceSquared(Point v0,Point v1,float X,float Y) {
+    float vx = v0.x - X, vy = v0.y - Y, ux = v1.x - v0.x, uy = v1.y - v0.y;
+    float length = ux * ux + uy * uy;
+    float det = (-vx * ux) + (-vy * uy);
+    if (det < 0)
+        return (v0.x - X) * (v0.x - X) + (v0.y - Y) * (v0.y - Y);
+    if (det > length)
+        return (v1.x - X) * (v1.x - X) + (v1.y - Y) * (v1.y - Y);
+    det = ux * vy - uy * vx;
+    return (det * det) / length;
+}
+static bool legacyOverlapY(Point v0,Point v1,const Vec4i &other) {
+    float s1 = std::min(v0.y,v1.y), e1 = std::max(v0.y,v1.y);
+    float v = std::min(other[1],other[3]), w = std::max(other[1],other[3]);
+    return (e1>v) && (s1<w);
+}
+static bool legacyIsLeft(Point a,Point b,Point c) {
+    return ((b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x)) > 0;
+}
+static bool legacyCross(Point v0,Point v1,const Vec4i &other) {
+    return legacyIsLeft(v0,v1,Point(other[0],other[1]))!=legacyIsLeft(v0,v1,Point(other[2],other[3]));
+}
+static bool legacyScan(Point v0,Point v1,vector<Vec4i> &lines,double &closest,vector<Vec4i>::iterator &closest_line,
+                       vector<Vec4i>::iterator skip_iter) {
+    bool found_closer=false;
+    for(auto iter3=lines.begin(); iter3!=lines.end(); ++iter3) {
+        if(iter3==skip_iter || legacyCross(v0,v1,*iter3) || !legacyOverlapY(v0,v1,*iter3))
+            continue;
+        double dist1 = legacyDistanceSquared(v0,v1,(*iter3)[0],(*iter3)[1]);
+        double dist2 = legacyDistanceSquared(v0,v1,(*iter3)[2],(*iter3)[3]);
+        if((dist1<0) || (dist2<0))
+            continue;
+        double avg_dist = (sqrt(dist1)+sqrt(dist2))/2.0;
+        if(avg_dist<closest) {
+            closest = avg_dist;
+            closest_line = iter3;
+            found_closer = true;
+        }
+    }
+    return found_closer;
+}
+static void legacyPairLines(vector<Vec4i> &lines,Pairs &pairs) {
+    map<int,vector<Vec4i> > same_angle;
+    for(auto iter=lines.begin(); iter!=lines.end();) {
+        const Vec4i &ln(*iter);
+        double angle = fabs(ln[0]-ln[3])<0.0001 ? M_PI/2 : atan(fabs(ln[1]-ln[3])/fabs(ln[0]-ln[2]));
+        if(fabs(angle-M_PI/2)>8*(M_PI/180))
+            iter = lines.erase(iter);
+        else {
+            same_angle[int(2*(angle*180/M_PI))].push_back(ln);
+            ++iter;
+        }
+    }
+    for(auto iter=same_angle.begin(); iter!=same_angle.end(); ++iter) {
+        vector<Vec4i> &x(iter->second);
+        auto iter_next = iter, iter_prev = iter;
+        iter_next++;
+        iter_prev--;
+        if(iter==same_angle.begin())
+            iter_prev = (++same_angle.rbegin()).base();
+        if(iter_next==same_angle.end())
+            iter_next = same_angle.begin();
+        vector<Vec4i> &prev_x(iter_prev->second), &next_x(iter_next->second);
+        for(auto iter2=x.begin(); iter2!=x.end();) {
+            Point v0((*iter2)[0],(*iter2)[1]), v1((*iter2)[2],(*iter2)[3]);
+            vector<Vec4i>::iterator closest_line;
+            double closest = 1000000;
+            int container = 0;
+            if(legacyScan(v0,v1,x,closest,closest_line,iter2))
+                container = 0;
+            if(legacyScan(v0,v1,prev_x,closest,closest_line,iter2))
+                container = 1;
+            if(legacyScan(v0,v1,next_x,closest,closest_line,iter2))
+                container = 2;
+            if(closest>5 && closest<120) {
+                pairs.push_back(make_pair(*iter2,*closest_line));
+                vector<Vec4i> &partner_x(container==0 ? x : container==1 ? prev_x : next_x);
+                // pairLines erased the partner first, which moved iter2 onto the next segment when the partner
+                // came before it in the same bucket
+                ptrdiff_t at = iter2-x.begin();
+                if(&partner_x==&x && closest_line<iter2)
+                    at--;
+                partner_x.erase(closest_line);
+                iter2 = x.erase(x.begin()+at);
+            }
+            else
+                ++iter2;
+        }
+    }
+}
+// Near vertical segment clouds at a constant density, about one stem edge pair per 100x400 pixels with a third of
+// the segments tilted past the pairing limit
+static vector<Vec4i> segmentCloud(int n) {
+    mt19937 rng(n);
+    uniform_real_distribution<double> unit(0,1);
+    const double side = sqrt(n/2.0)*120;
+    vector<Vec4i> lines;
+    while(int(lines.size())<n) {
+        double x = unit(rng)*side, y = unit(rng)*side;
+        double len = 20+unit(rng)*180;
+        double tilt = (unit(rng)-0.5)*24*(M_PI/180);
+        Vec4i ln(int(x),int(y),int(x+len*sin(tilt)),int(y+len*cos(tilt)));
+        lines.push_back(ln);
+        if(unit(rng)<0.5 && int(lines.size())<n) {
+            double gap = 10+unit(rng)*60;
+            lines.push_back(Vec4i(ln[0]+int(gap),ln[1]+int(unit(rng)*20),ln[2]+int(gap),ln[3]));
+        }
+    }
+    return lines;
+}
+static void BM_PairLegacy(benchmark::State &state) {
+    const vector<Vec4i> cloud = segmentCloud(state.range(0));
+    for(auto _ : state) {
+        vector<Vec4i> lines = cloud;
+        Pairs pairs;
+        legacyPairLines(lines,pairs);
+        benchmark::DoNotOptimize(pairs.data());
+    }
+    state.SetItemsProcessed(state.iterations()*cloud.size());
+}
+static void BM_PairGrid(benchmark::State &state) {
+    const vector<Vec4i> cloud = segmentCloud(state.range(0));
+    SegmentPairer pairer;
+    if(cloud.size()<=10000) {
+        vector<Vec4i> lines = cloud, legacy_lines = cloud;
+        Pairs pairs, legacy_pairs;
+        pairer.pair(lines,pairs);
+        legacyPairLines(legacy_lines,legacy_pairs);
+        if(pairs!=legacy_pairs || lines!=legacy_lines) {
+            state.SkipWithError("grid pairs differ from the quadratic scan");
+            return;
+        }
+    }
+    for(auto _ : state) {
+        vector<Vec4i> lines = cloud;
+        Pairs pairs;
+        pairer.pair(lines,pairs);
+        benchmark::DoNotOptimize(pairs.data());
+    }
+    state.SetItemsProcessed(state.iterations()*cloud.size());
+    state.counters["pairs"] = pairer.stats().pairs;
+    state.counters["candidates/segment"] = double(pairer.stats().candidates)/std::max<size_t>(1,cloud.size());
+}
+BENCHMARK(BM_PairLegacy)->RangeMultiplier(10)->Range(1000,10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_PairGrid)->RangeMultiplier(10)->Range(1000,100000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
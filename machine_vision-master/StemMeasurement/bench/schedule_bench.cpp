@@ -0,0 +1,88 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "MeasurementPipeline.h"
+#include "ThreadSchedule.h"
+
+using namespace std;
+using namespace cv;
+
+// Images listed in the file named by STEM_BENCH_CORPUS ( one path per line ), or synthetic frames written to the
+// temp directory. Synthetic frames have no wire, so they only exercise the first half of the pipeline.
+static const vector<string> &corpus() {
+    static vector<string> images;
+    if(!images.empty())
+        return images;
+    const char *list = getenv("STEM_BENCH_CORPUS");
+    if(list) {
+        ifstream in(list);
+        string line;
+        while(getline(in,line)) {
+            if(!line.empty() && line[0]!='#')
+                images.push_back(line);
+        }
+        return images;
+    }
+    StemParams params;
+    Size frame_size(params.crop_area.x+params.crop_area.width+200,params.crop_area.y+params.crop_area.height+200);
+    const char *tmp = getenv("TMPDIR");
+    for(int i=0; i<16; ++i) {
+        char name[64];
+        snprintf(name,sizeof(name),"/stem_schedule_bench_%d.jpg",i);
+        string file = string(tmp ? tmp : "/tmp")+name;
+        Mat small(frame_size.height/16,frame_size.width/16,CV_8UC3),frame;
+        randu(small,Scalar::all(0),Scalar::all(256));
+        resize(small,frame,frame_size,0,0,INTER_CUBIC);
+        imwrite(file,frame);
+        images.push_back(file);
+    }
+    return images;
+}
+// args: ScheduleMode, then workers for inter-image or OpenCV threads for intra-image ( 0 - as planned )
+static void BM_Schedule(benchmark::State &state) {
+    const vector<string> &images = corpus();
+    ScheduleMode mode = ScheduleMode(state.range(0));
+    SchedulePlan plan = planSchedule(mode,images.size());
+    if(state.range(1)>0) {
+        if(plan.mode==SCHEDULE_INTER_IMAGE)
+            plan.workers = state.range(1);
+        else
+            plan.opencv_threads = state.range(1);
+    }
+    applySchedule(plan);
+    PipelineOptions opts;
+    opts.workers = plan.workers;
+    opts.decoders = plan.decoders;
+    double measure_util = 0;
+    double wall_s = 0;
+    for(auto _ : state) {
+        PipelineStats stats = MeasurementPipeline(opts).run(images,[](size_t,const string &,const StemResult &) {});
+        measure_util += stats.measure.utilisation(stats.wall_s);
+        wall_s += stats.wall_s;
+    }
+    char label[96];
+    snprintf(label,sizeof(label),"%s, %d workers, %d OpenCV threads",scheduleModeName(plan.mode),plan.workers,
+             plan.opencv_threads);
+    state.SetLabel(label);
+    state.counters["images/s"] = wall_s>0 ? images.size()*state.iterations()/wall_s : 0;
+    state.counters["measure_busy"] = measure_util/state.iterations();
+}
+static void scheduleArgs(benchmark::internal::Benchmark *b) {
+    b->Args({SCHEDULE_AUTO,0});
+    for(int n : {1,2,4,availableCores()}) {
+        b->Args({SCHEDULE_INTER_IMAGE,n});
+        b->Args({SCHEDULE_INTRA_IMAGE,n});
+    }
+}
+BENCHMARK(BM_Schedule)->Apply(scheduleArgs)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,207 @@
+#include <cmath>
+#include <map>
+
+#include <benchmark/benchmark.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "ImageContext.h"
+#include "StemMeasurer.h"
+#include "SyntheticFrame.h"
+
+using namespace std;
+using namespace cv;
+
+// The private stages of StemMeasurer, called one at a time
+struct StemStageBench
+{
+    static StemWorkspace &workspace(StemMeasurer &m) { return m.m_ws; }
+    static int findHangLine(StemMeasurer &m, const Mat &src, StemResult &res) { return m.findHangLine(src,res); }
+    static const Mat &wireEdges(StemMeasurer &m, ImageContext &ctx) { return m.wireEdges(ctx); }
+    static float stemWidth(StemMeasurer &m, ImageContext &area) { return m.stemWidth(area); }
+    static float verifyStems(StemMeasurer &m, const Mat1b &edges) { return m.stemWidthFromEdges(edges,nullptr); }
+    static void trimToGreen(StemMeasurer &m, Rect &r, const Mat3b &pic) { m.trimToGreen(r,pic); }
+};
+
+// Every benchmark takes the frame scale in percent of the camera resolution. The frames have no leaf in the stem
+// window, so the measured width can be compared with the drawn one.
+struct BenchFrame
+{
+    SyntheticFrameSpec spec;
+    Mat                frame;
+    Mat                median;
+    Rect               window; // stemWindow of the drawn plant top, frame coordinates
+};
+static const BenchFrame &benchFrame(int percent) {
+    static map<int,BenchFrame> frames;
+    BenchFrame &f(frames[percent]);
+    if(!f.frame.empty())
+        return f;
+    StemParams params;
+    f.spec = scaledFrameSpec(percent/100.0);
+    int offset = cvRound(params.stem_offset_mm/params.pixel_to_mm);
+    f.window = Rect(0,f.spec.plant_top+offset-params.stem_window_rows/2,f.spec.size.width,params.stem_window_rows);
+    f.window &= Rect(Point(0,0),f.spec.size);
+    f.spec.leaf_free_rows = f.window;
+    f.frame = syntheticPlantFrame(f.spec);
+    medianBlur(f.frame,f.median,3);
+    return f;
+}
+// A run that finds a width this far from the drawn one took a failure path, its time says nothing about the stages
+static bool widthOff(float width, const SyntheticFrameSpec &spec) {
+    return !(std::fabs(width-spec.stem_width)<=std::max(3.0,spec.stem_width*0.1));
+}
+// Shown as s/pixel, so 1.2n is 1.2 nanoseconds per pixel of the stage input
+static void perPixel(benchmark::State &state, double pixels) {
+    state.counters["s/pixel"] = benchmark::Counter(pixels,benchmark::Counter::kIsIterationInvariantRate |
+                                                              benchmark::Counter::kInvert);
+}
+static void BM_Median(benchmark::State &state) {
+    const BenchFrame &f(benchFrame(state.range(0)));
+    Mat pic;
+    for(auto _ : state) {
+        medianBlur(f.frame,pic,3);
+        benchmark::DoNotOptimize(pic.data);
+    }
+    perPixel(state,f.frame.total());
+}
+static void BM_Equalize(benchmark::State &state) {
+    const BenchFrame &f(benchFrame(state.range(0)));
+    StemMeasurer m;
+    ImageContext ctx(f.median,&StemStageBench::workspace(m));
+    for(auto _ : state) {
+        ctx.reset(f.median);
+        benchmark::DoNotOptimize(ctx.equalizedRgb().data);
+    }
+    perPixel(state,f.frame.total());
+}
+// The equalized planes are computed outside of the timed part
+static void BM_WireEdges(benchmark::State &state) {
+    const BenchFrame &f(benchFrame(state.range(0)));
+    StemMeasurer m;
+    ImageContext ctx(f.median,&StemStageBench::workspace(m));
+    for(auto _ : state) {
+        state.PauseTiming();
+        ctx.reset(f.median);
+        ctx.equalizedHsv();
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(StemStageBench::wireEdges(m,ctx).data);
+    }
+    perPixel(state,f.frame.total());
+}
+static void BM_TrimToGreen(benchmark::State &state) {
+    const BenchFrame &f(benchFrame(state.range(0)));
+    StemMeasurer m;
+    ImageContext ctx(f.median);
+    const Mat3b rgb(ctx.equalizedRgb());
+    for(auto _ : state) {
+        Rect r = f.window;
+        StemStageBench::trimToGreen(m,r,rgb);
+        benchmark::DoNotOptimize(r);
+    }
+    perPixel(state,f.window.area());
+}
+static void BM_StemWidth(benchmark::State &state) {
+    const BenchFrame &f(benchFrame(state.range(0)));
+    StemMeasurer m;
+    ImageContext ctx(f.median);
+    ImageContext first_area = ctx.roi(f.window,&StemStageBench::workspace(m));
+    float width = StemStageBench::stemWidth(m,first_area);
+    if(widthOff(width,f.spec)) {
+        state.SkipWithError("the stem width is off");
+        return;
+    }
+    for(auto _ : state) {
+        ImageContext area = ctx.roi(f.window,&StemStageBench::workspace(m));
+        width = StemStageBench::stemWidth(m,area);
+    }
+    perPixel(state,f.window.area());
+    state.counters["d_width_px"] = width-f.spec.stem_width;
+}
+// Index of the stem edges, candidate rows and verifyStems for each of them, on the edges stemWidth found
+static void BM_VerifyStems(benchmark::State &state) {
+    const BenchFrame &f(benchFrame(state.range(0)));
+    StemMeasurer m;
+    ImageContext ctx(f.median);
+    ImageContext area = ctx.roi(f.window);
+    StemStageBench::stemWidth(m,area);
+    const Mat1b edges = StemStageBench::workspace(m).mat(WS_STEM_EDGES,f.window.size(),CV_8UC1).clone();
+    float width = StemStageBench::verifyStems(m,edges);
+    if(widthOff(width,f.spec)) {
+        state.SkipWithError("the stem width is off");
+        return;
+    }
+    for(auto _ : state)
+        width = StemStageBench::verifyStems(m,edges);
+    perPixel(state,f.window.area());
+    state.counters["d_width_px"] = width-f.spec.stem_width;
+}
+static void BM_FindHangLine(benchmark::State &state) {
+    const BenchFrame &f(benchFrame(state.range(0)));
+    StemMeasurer m;
+    StemResult res;
+    StemStageBench::findHangLine(m,f.frame,res);
+    if(res.status!=STEM_OK || widthOff(res.stem_width_px,f.spec)) {
+        state.SkipWithError(res.status!=STEM_OK ? stemStatusName(res.status) : "the stem width is off");
+        return;
+    }
+    for(auto _ : state) {
+        res = StemResult();
+        StemStageBench::findHangLine(m,f.frame,res);
+    }
+    perPixel(state,f.frame.total());
+    state.counters["status"] = res.status;
+    state.counters["d_wire_x"] = res.hang_line_x-f.spec.wire_x;
+}
+static bool sameResult(const StemResult &a, const StemResult &b) {
+    return a.status==b.status && a.hang_line_x==b.hang_line_x && a.plant_top==b.plant_top &&
+           a.stem_area==b.stem_area && a.stem_width_px==b.stem_width_px;
+}
+// measure() end to end, in frames per second. A measurer that saw a larger frame with another layout first must
+// give the result of a new one, its workspace buffers must not carry pixels from one frame into the next, and a
+// measurer that saw the frame before must not allocate.
+static void BM_Frame(benchmark::State &state) {
+    const BenchFrame &f(benchFrame(state.range(0)));
+    StemMeasurer m;
+    StemResult res;
+    SyntheticFrameSpec other = scaledFrameSpec(std::min(2.0,state.range(0)*1.5/100));
+    other.wire_x += other.size.width/10;
+    other.stem_width += 4;
+    other.seed += 1;
+    StemMeasurer used;
+    used.measure(syntheticPlantFrame(other));
+    res = m.measure(f.frame);
+    if(res.status!=STEM_OK || widthOff(res.stem_width_px,f.spec)) {
+        state.SkipWithError(res.status!=STEM_OK ? stemStatusName(res.status) : "the stem width is off");
+        return;
+    }
+    if(!sameResult(used.measure(f.frame),res)) {
+        state.SkipWithError("the result depends on the frame measured before");
+        return;
+    }
+    // every buffer, the stem window planes included, comes from the workspace once it has seen the frame
+    if(m.measure(f.frame).allocated_bytes!=0) {
+        state.SkipWithError("the second measurement of the frame allocated");
+        return;
+    }
+    for(auto _ : state)
+        res = m.measure(f.frame);
+    perPixel(state,f.frame.total());
+    state.counters["frames/s"] = benchmark::Counter(state.iterations(),benchmark::Counter::kIsRate);
+    state.counters["status"] = res.status;
+    state.counters["d_width_px"] = res.stem_width_px-f.spec.stem_width;
+}
+static void frameScales(benchmark::internal::Benchmark *b) {
+    b->Arg(50)->Arg(100)->Arg(200)->Unit(benchmark::kMicrosecond);
+}
+BENCHMARK(BM_Median)->Apply(frameScales);
+BENCHMARK(BM_Equalize)->Apply(frameScales);
+BENCHMARK(BM_WireEdges)->Apply(frameScales);
+BENCHMARK(BM_TrimToGreen)->Apply(frameScales);
+BENCHMARK(BM_StemWidth)->Apply(frameScales);
+BENCHMARK(BM_VerifyStems)->Apply(frameScales);
+BENCHMARK(BM_FindHangLine)->Apply(frameScales);
+BENCHMARK(BM_Frame)->Apply(frameScales);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,83 @@
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "ImageLoader.h"
+#include "StemMeasurer.h"
+
+using namespace std;
+using namespace cv;
+
+// Crop areas of the frames listed in the file named by STEM_BENCH_CORPUS, in the order the platform took them, or a
+// synthetic lane: a bright wire over a plant with a stem, drifting a few pixels from frame to frame
+static const vector<Mat> &sequence() {
+    static vector<Mat> frames;
+    if(!frames.empty())
+        return frames;
+    StemParams params;
+    const char *list = getenv("STEM_BENCH_CORPUS");
+    if(list) {
+        ifstream in(list);
+        string line;
+        while(getline(in,line)) {
+            if(line.empty() || line[0]=='#')
+                continue;
+            Mat pic = loadImageRoi(line,params.crop_area);
+            if(!pic.empty())
+                frames.push_back(pic);
+        }
+        return frames;
+    }
+    const Size sz = params.crop_area.size();
+    for(int i=0; i<32; ++i) {
+        Mat frame(sz,CV_8UC3,Scalar(40,50,60));
+        int x = sz.width/2+int(12*sin(i*0.3));
+        int top = 600+3*(i%8);
+        line(frame,Point(x,0),Point(x,top),Scalar(235,235,235),8);
+        ellipse(frame,Point(x,top+150),Size(220,150),0,0,360,Scalar(40,170,60),-1);
+        rectangle(frame,Point(x-15,top+150),Point(x+15,sz.height),Scalar(50,150,70),-1);
+        frames.push_back(frame);
+    }
+    return frames;
+}
+// arg: 0 - every frame searched fully, 1 - measureTracked
+static void BM_Sequence(benchmark::State &state) {
+    const vector<Mat> &frames = sequence();
+    if(frames.empty()) {
+        state.SkipWithError("no frames");
+        return;
+    }
+    const bool tracking = state.range(0)!=0;
+    StemMeasurer measurer;
+    vector<StemResult> reference;
+    for(const Mat &pic : frames)
+        reference.push_back(measurer.measure(pic));
+    size_t tracked = 0, same_status = 0;
+    double width_diff = 0;
+    for(auto _ : state) {
+        StemTrack track;
+        for(size_t i=0; i<frames.size(); ++i) {
+            StemResult res = tracking ? measurer.measureTracked(frames[i],track) : measurer.measure(frames[i]);
+            tracked += res.tracked;
+            same_status += res.status==reference[i].status;
+            if(res.status==STEM_OK && reference[i].status==STEM_OK)
+                width_diff = std::max<double>(width_diff,fabs(res.stem_width_px-reference[i].stem_width_px));
+        }
+    }
+    const double n = double(state.iterations())*frames.size();
+    state.SetItemsProcessed(int64_t(n));
+    state.counters["frames/s"] = benchmark::Counter(n,benchmark::Counter::kIsRate);
+    state.counters["tracked"] = tracked/n;
+    state.counters["same_status"] = same_status/n;
+    state.counters["max_d_width_px"] = width_diff;
+}
+BENCHMARK(BM_Sequence)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
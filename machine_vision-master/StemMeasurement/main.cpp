@@ -7,12 +7,32 @@
 #include <string>
 #include <QtCore/QCoreApplication>
 #include "opencv2/highgui/highgui.hpp"
+#include "BatchRunner.h"
+#include "DebugSink.h"
+#include "StemMeasurer.h"
+#include "ThreadSchedule.h"
 
-extern void testCV(int argc,char **argv);
+static int testCV(const char *image_path)
+{
+    // a single image, its OpenCV calls get all cores
+    SchedulePlan plan = planSchedule(SCHEDULE_AUTO,1);
+    applySchedule(plan);
+    printSchedule(stdout,plan);
+    StemParams params;
+    params.verbose = true;
+    StemResult res = StemMeasurer(params).measureFile(image_path);
+    printf("%s: %s, plant top %d, stem width %f mm, %.1f ms\n",image_path,stemStatusName(res.status),res.plant_top,
+           res.stem_width_mm,res.elapsed_ms);
+    return res.status==STEM_OK ? 0 : 1;
+}
 int main(int argc, char* argv[])
 {
-    cv::setNumThreads(2);
     QCoreApplication app(argc, argv);
-    testCV(argc,argv);
-    return app.exec();
+    BatchOptions opts;
+    bool batch = parseBatchOptions(argc,argv,opts);
+    if(opts.debug_level>DEBUG_OFF)
+        DebugSink::instance().start(opts.debug_dir,opts.debug_level);
+    int res = batch ? runBatch(opts) : testCV(opts.inputs.front().c_str());
+    DebugSink::instance().stop();
+    return res;
 }